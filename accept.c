@@ -5,114 +5,107 @@
  *
  * Accepting states are stored in a set with a function
  * to know if a state is an accepting state or not.
- * The set is first implemented as a list of states that is scanned
- * on each access, but if it grows large enough it is changed
- * in a bitfield that uses a single bit to store if a state is
- * present or not in the set. The maximum state value is needed to
- * calculate the bitfield size and the number of elements needed
- * to turn from list to bitfield.
+ * The set is a hash table with open addressing: each state is stored
+ * in the first empty slot from its hash on, so it takes a few probes
+ * at most to find it or an empty slot, whatever the state values are.
+ * Hash table grows twice larger when it is 1/2 full.
+ * Empty slots are zeroes, so state 0 is stored apart.
+ *
+ *   hash(s)
+ *      v
+ * [ 0 | 7 | 3 | 0 | 0 | 12 | 0 | 0 ]
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "accept.h"
-#include "bits.h"
+
+#define SET_MINSZ  8
+#define SET_MINBIT 3  /* log2(SET_MINSZ) */
 
 struct set{
-    enum {list, bits}  format;
-    state              max;
-    size_t             count;
-    void              *data;
+    state  *slot;
+    size_t  size,
+            count;
+    int     shift; /* 32 - log2(size), to keep the high bits of the hash */
+    int     zero;  /* True if 0 is in the set                            */
 };
 
-typedef struct state_list{
-    state              st;
-    struct state_list *next;
-} state_list;
-
-/* Format dependent functions */
-typedef void *put_funct(void*, state);
-typedef int   get_funct(void*, state);
-typedef void  del_funct(void*);
-put_funct list_put, * const f_put[] = {list_put, (put_funct*)bits_set};
-get_funct list_get, * const f_get[] = {list_get, (get_funct*)bits_get};
-del_funct delete_list,        * const f_del[] = {delete_list, free};
-
-char *list_to_bits(void**, size_t);
+/* Slot of st, or empty slot where it would be stored */
+state *set_slot(state *slot, size_t size, int shift, state st);
+/* Return 0 on success, else -1 */
+int    set_grow(set*);
 
 /******************** Set ********************/
 
 set *new_set(){
     set *s    = malloc(sizeof(*s));
     if(!s) return NULL;
-    s->format = list;
-    s->max    =
-    s->count  = 0;
-    s->data   = NULL;
+    s->slot   = calloc(SET_MINSZ, sizeof(*s->slot));
+    if(!s->slot){
+        free(s);
+        return NULL;
+    }
+    s->size   = SET_MINSZ;
+    s->shift  = 32 - SET_MINBIT;
+    s->count  =
+    s->zero   = 0;
     return s;
 }
 
-int set_put(set* s, state st){
-    size_t bits_sz = BYTES(s->max + 1);
-    /* if list is larger than bits convert to bitfield */
-    if(s->format == list && sizeof(state_list) * (s->count + 1) >= bits_sz){
-        if(list_to_bits(&s->data, bits_sz))
-            s->format = bits;
-    }
-    void *t = f_put[s->format](s->data, st);
-    if(t){
-        s->count++;
-        s->data = t;
-    }
-    return !!t;
+int set_put(set *s, state st){
+    state *t;
+    if(!st)
+        return s->zero = 1;
+    if(*(t = set_slot(s->slot, s->size, s->shift, st)))
+        return 1;
+    *t = st;
+    if(++s->count > s->size / 2 && set_grow(s))
+        return 0;
+    return 1;
 }
 
 int set_get(set *s, state st){
-    return f_get[s->format](s->data, st);
+    if(!st)
+        return s->zero;
+    return !!*set_slot(s->slot, s->size, s->shift, st);
 }
 
-void set_max(set *s, state max){
-    if(s->max < max)
-        s->max = max;
+void set_reset(set *s){
+    memset(s->slot, 0, s->size * sizeof(*s->slot));
+    s->count =
+    s->zero  = 0;
 }
 
-void delete_set(set *s){
-    f_del[s->format](s->data);
-    free(s);
-}
-
-/******************** List ********************/
-
-void *list_put(void *list, state st){
-    state_list* t = malloc(sizeof(*t));
-    if(!t) return NULL;
-    t->st         = st;
-    t->next       = list;
-    return t;
-}
-
-int list_get(void *list, state st){
-    for(; list; list = ((state_list*)list)->next)
-        if(((state_list*)list)->st == st)
-            return 1;
+int set_grow(set *s){
+    state *slot = calloc(s->size * 2, sizeof(*slot));
+    size_t i;
+    if(!slot)
+        return -1;
+    for(i = 0; i < s->size; i++)
+        if(s->slot[i])
+            *set_slot(slot, s->size * 2, s->shift - 1, s->slot[i]) =
+                s->slot[i];
+    free(s->slot);
+    s->slot  = slot;
+    s->size *= 2;
+    s->shift--;
     return 0;
 }
 
-char *list_to_bits(void **list, size_t size){
-    char *bits = calloc(size, sizeof(*bits));
-    if(!bits)
-        return NULL;
-    state_list* l;
-    for(l = *(state_list**)list; l; l = l->next)
-        bits_set(bits, l->st);
-    delete_list(*list);
-    return *list = bits;
+/*
+ * Fibonacci hashing, size is a power of 2: the high bits of the 32 bit
+ * product depend on all the bits of st, the low ones only on its low bits
+ */
+state *set_slot(state *slot, size_t size, int shift, state st){
+    size_t i;
+    for(i = ((st * 2654435769u) & 0xffffffffu) >> shift;
+        slot[i] && slot[i] != st;
+        i = (i + 1) & (size - 1));
+    return slot + i;
 }
 
-void delete_list(void *list){
-    state_list *t;
-    while(list){
-        t = ((state_list*)list)->next;
-        free(list);
-        list = t;
-    }
+void delete_set(set *s){
+    free(s->slot);
+    free(s);
 }
@@ -14,7 +14,7 @@ typedef struct set set;
 set* new_set();
 int  set_put(set*, state);
 int  set_get(set*, state);     /* True if the state is stored in the set */
-void set_max(set*, state max); /* Set the maximum element in the set     */
+void set_reset(set*);          /* Remove all the states                  */
 void delete_set(set*);
 
 #endif
@@ -0,0 +1,3135 @@
+/*
+ * types.h:   Common typedefs
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef TYPES_H
+#define TYPES_H
+
+/*
+ * POSIX clocks and syscall, see profile.c. The Makefile defines it for
+ * every source, this is for the single file where types.h comes first
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+typedef unsigned int state;
+typedef char         symbol;
+
+#endif
+/*
+ * bits.h:    Bitfield
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef BITS_H
+#define BITS_H
+
+#include <stdlib.h>
+
+#define BYTES(BITS) (((BITS) >> 3) + !!((BITS) & 7))
+
+char *bits_set   (char*, size_t);
+char *bits_unset (char*, size_t);
+char *bits_toggle(char*, size_t);
+int   bits_get   (char*, size_t);
+
+/* Return next available index in bitfield or -1 if the it's full */
+size_t bits_next_avail(char*, size_t len, size_t start);
+
+#endif
+/*
+ * tape.c:    Machine tape data structures
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <string.h>
+
+struct tape{
+    symbol *tail[2];
+    size_t  size[2];
+    long    head;
+};
+
+typedef struct tape tape;
+
+/*
+ * Initialize a new tape containing the string passed
+ * blank are replaced with zeroes and term, if present,
+ * marks the end of the string (to ignore trailing \n)
+ */
+tape  *tape_init  (symbol*, symbol blank, symbol *term);
+/* Branch the current tape and return a pointer to the new copy created */
+tape  *tape_branch(tape*);
+
+/*
+ * Count the cells from the head on, moving by mv, that hold ch or,
+ * if set is not NULL, any symbol c with set[c] not zero, as a table of
+ * all the symbols. Counting stops at max, cells beyond the tape are
+ * blank. The tape is not modified.
+ */
+size_t tape_span  (tape*, int mv, symbol ch, char *set, size_t max);
+/* Move the head n cells by mv, growing the tape if needed */
+tape  *tape_skip  (tape*, size_t n, int mv);
+
+static inline symbol tape_read(tape *t){
+    if(t->head < 0) return t->tail[0][~t->head];
+    return t->tail[1][t->head];
+}
+
+/* True if the head is on the last cell of the tape moving by mv */
+static inline int tape_edge(tape *t, int mv){
+    return t->head == (mv > 0 ? (long)t->size[1] - 1 : -(long)t->size[0]);
+}
+
+static inline tape *tape_write(tape *t, symbol write, int move){
+    if(t->head < 0) t->tail[0][~t->head] = write;
+    else t->tail[1][t->head] = write;
+    t->head += move;
+    if(t->head >= (signed)t->size[1]){
+        t->tail[1] = realloc(t->tail[1], (t->head + 1) * sizeof(**t->tail));
+        memset(t->tail[1] + t->size[1], 0, move);
+        t->size[1] = t->head + 1;
+    }
+    else if(t->head < -(signed)t->size[0]){
+        t->tail[0] = realloc(t->tail[0], -t->head * sizeof(**t->tail));
+        memset(t->tail[0] + t->size[0], 0, -move);
+        t->size[0] = -t->head;
+    }
+    return t;
+}
+void   delete_tape(tape*);
+
+#endif
+/*
+ * rules.h:   Rules dictionary functions
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+
+typedef unsigned int     hash;
+
+struct rule{
+    state  st_from,
+           st_dest;
+    symbol ch_from,
+           ch_dest;
+    int    mv_dest;
+};
+
+typedef struct rule_dict rule_dict;
+typedef struct rule_list rule_list;
+typedef struct rule_dest rule_dest;
+
+struct rule_dict{
+    rule_list **rule;
+    size_t      size,
+                count;
+    rule_list  *pool_list; /* Nodes of deleted rules, to be reused */
+    rule_dest  *pool_dest;
+};
+
+struct rule_list{
+    hash          hash;
+    state         st;
+    symbol        ch;
+    rule_dest    *dest;
+    rule_list    *next;
+    unsigned int  dist;    /* Heuristic estimate, see heuristic.c   */
+    struct macro *macro;   /* Macro step from this rule, see macro.c */
+    int           runaway; /* Direction of a runaway, see macro.c    */
+    int           share;   /* Destinations sharing a tape, see core.c */
+};
+
+/* List of non deterministic destinations for each rule */
+struct rule_dest{
+    state       st;
+    int         mv;
+    symbol      ch;
+    char        acc;   /* True if st is an accepting state */
+    rule_dest  *next;
+};
+
+static inline hash hash_f(state st, symbol ch){
+    return st * 5 + ch * 3;
+}
+
+/* Return the dictionary or NULL if malloc fails */
+rule_dict *new_rule_dict   ();
+
+static inline rule_list *rule_list_find(rule_list *rule, state st, symbol ch){
+    for(; rule; rule = rule->next)
+        if(rule->st == st &&
+           rule->ch == ch)
+            return rule;
+    return NULL;
+}
+
+static inline rule_list *rule_dict_lookup(rule_dict *dict,
+                                          state st, symbol ch){
+    hash h = hash_f(st, ch);
+    return rule_list_find(dict->rule[h % dict->size], st, ch);
+}
+
+static inline rule_dest *rule_dict_find(rule_dict *dict, state st, symbol ch){
+    rule_list *r = rule_dict_lookup(dict, st, ch);
+    return r ? r->dest : NULL;
+}
+
+/* Return 0 on success, else -1 */
+int        rule_dict_insert(rule_dict*, struct rule*);
+/* Remove all the rules, keeping their memory for the next ones */
+void       rule_dict_reset (rule_dict*);
+void       delete_rule_dict(rule_dict*);
+
+#endif
+/*
+ * accept.h:  Accept states set
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef ACCEPT_H
+#define ACCEPT_H
+
+
+typedef struct set set;
+
+set* new_set();
+int  set_put(set*, state);
+int  set_get(set*, state);     /* True if the state is stored in the set */
+void set_reset(set*);          /* Remove all the states                  */
+void delete_set(set*);
+
+#endif
+/*
+ * queue.h:   Configuration queue
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+
+struct queue{
+    struct tmconf *head;
+    struct tmconf *tail;
+};
+
+/*
+ * A tape with the set of states the machine may be in on it, sorted and
+ * without duplicates, so that branches writing and moving the same way
+ * share one tape
+ */
+struct tmconf{
+    unsigned int   ttl;
+    tape          *t;
+    struct tmconf *next;
+    size_t         n;    /* States in the set          */
+    size_t         size; /* Room for states in the set */
+    state          st[];
+};
+
+typedef struct queue queue;
+
+/* Return a configuration with room for n states and no tape, or NULL */
+struct tmconf *new_tmconf   (size_t n);
+
+/*
+ * Make room for n states, the configuration may be moved
+ * Return the configuration, or NULL leaving it unchanged
+ */
+struct tmconf *tmconf_resize(struct tmconf*, size_t n);
+
+void           delete_tmconf(struct tmconf*);
+
+queue         *new_queue   ();
+
+static inline void enqueue(queue *q, struct tmconf *conf){
+    q->head       = q->head ?
+    q->head->next = conf    : (
+    q->tail       = conf  ) ;
+}
+
+/* Insert at the tail, so that the configuration is dequeued first (LIFO) */
+static inline void push(queue *q, struct tmconf *conf){
+    if(!(conf->next = q->tail))
+        q->head = conf;
+    q->tail = conf;
+}
+
+static inline struct tmconf *dequeue(queue *q){
+    struct tmconf *conf;
+    if((conf = q->tail)){
+        q->tail = conf->next;
+        conf->next = NULL;
+    }
+    if(!q->tail)
+        q->head = NULL;
+    return conf;
+}
+
+void           delete_queue(queue*);
+
+#endif
+/*
+ * heap.h:    Configuration priority queue
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdlib.h>
+
+struct heap_node{
+    unsigned int   key;
+    struct tmconf *conf;
+};
+
+struct heap{
+    struct heap_node *node;
+    size_t            size,
+                      count;
+};
+
+typedef struct heap heap;
+
+/* Return the heap or NULL if malloc fails */
+heap          *new_heap   ();
+/* Return 0 on success, else -1 */
+int            heap_push  (heap*, unsigned int key, struct tmconf*);
+/* Return the configuration with the lowest key, NULL if heap is empty */
+struct tmconf *heap_pop   (heap*);
+void           delete_heap(heap*);
+
+#endif
+/*
+ * core.h:    Turing machine core
+ *
+ * Author:    Giorgio Pristia
+ */
+	
+#ifndef CORE_H
+#define CORE_H
+
+
+struct machine;
+
+/* Order in which the configurations of a run are explored */
+enum strategy{
+    search_bfs,   /* Breadth-first, configurations in a queue             */
+    search_dfs,   /* Depth-first, configurations in a stack               */
+    search_iddfs, /* Iterative deepening depth-first on a single tape     */
+    search_best   /* Best-first, configurations in a heap by heuristic    */
+};
+
+/* Heuristic for best-first search, lower values are explored first */
+typedef unsigned int h_eval_funct(struct machine*, struct tmconf*);
+typedef int          h_load_funct(struct machine*);
+
+struct heuristic{
+    h_load_funct *load; /* Called once the machine is loaded, may be NULL */
+    h_eval_funct *eval;
+};
+
+/* Counters accumulated over all the machines and runs */
+struct tm_stats{
+    unsigned long states,     /* States and rules loaded                    */
+                  rules,
+                  min_states, /* States and rules after minimization        */
+                  min_rules,
+                  runs,       /* Strings run                                */
+                  expanded,   /* Configurations with outgoing transitions   */
+                  branched,   /* Tapes copied on non deterministic branches */
+                  shared,     /* Branches sharing the tape of another one   */
+                  peak,       /* Largest frontier, or deepest IDDFS stack   */
+                  macro,      /* Steps taken by macro steps                 */
+                  runaway,    /* Branches found running away on blanks      */
+                  lockstep;   /* Strings run in lockstep                    */
+};
+
+/* Machine settings */
+struct machine{
+    rule_dict              *rules;
+    set                    *accept;
+    unsigned int            max;
+    enum strategy           strategy;
+    const struct heuristic *h;
+    struct macro           *macros;
+    int                     lockstep; /* Run deterministic machines in    */
+    struct lanes           *lanes;    /* lockstep batches, see lockstep.c */
+    struct tm_step         *step;     /* Destinations of the states being */
+    size_t                  nstep;    /* expanded                         */
+    struct profile         *prof;     /* Runs timed if not NULL, see      */
+                                      /* profile.c                        */
+    struct tm_stats         stats;
+};
+
+int  tm_init   (struct machine*);
+
+/*
+ * Prepare the machine for running once rules, accept states and max
+ * moves have been read
+ * Return 0 on success, else -1
+ */
+int  tm_load   (struct machine*);
+
+/*
+ * Takes a tm and a starting configuration: tape, state and time to live
+ * Returns the resulting state of the machine
+ * Return  0: not accept
+ *         1: accept
+ *         2: non terminating
+ *        -1: memory error
+ * The result does not depend on the strategy
+ */
+int  tm_run    (struct machine*, struct tmconf*);
+
+/* Clear rules, accept states and max moves to load a new machine */
+void tm_reset  (struct machine*);
+void tm_destroy(struct machine*);
+
+#endif
+/*
+ * heuristic.h: Best-first search heuristics
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+
+/*
+ * Least number of transitions from the current state and symbol
+ * to an accepting state, ignoring the rest of the tape
+ */
+extern const struct heuristic h_accept_dist;
+
+#endif
+/*
+ * macro.h:   Macro steps
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef MACRO_H
+#define MACRO_H
+
+
+struct macro{
+    enum {macro_sweep, /* Rules leaving symbol, state unchanged and move  */
+          macro_chain, /* Deterministic stationary rules                  */
+          macro_loop   /* Deterministic stationary rules that never end   */
+    }             type;
+    int           mv;    /* Sweep direction                               */
+    char         *set;   /* Swept symbols table, if more than ch          */
+    symbol        ch;    /* Swept symbol or symbol left by the chain      */
+    state         st;    /* State reached by the chain                    */
+    unsigned int  len;   /* Chain length or number of swept symbols       */
+    struct macro *next;
+};
+
+/*
+ * Find sweeps, chains and runaways in the rules of a loaded machine,
+ * reusing the macros of the previous one
+ * Return 0 on success, else -1
+ */
+int           macro_load  (struct machine*);
+
+/*
+ * Return the number of steps the macro takes from the current tape,
+ * or max + 1 if the macro takes more than max steps
+ */
+unsigned long macro_len   (struct macro*, tape*, unsigned int max);
+/* Apply the macro taking n steps, as returned by macro_len */
+tape         *macro_apply (struct macro*, state*, tape*, unsigned long n);
+
+void          delete_macro(struct macro*);
+
+#endif
+/*
+ * minimize.h: Machine state minimization
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef MINIMIZE_H
+#define MINIMIZE_H
+
+
+/*
+ * Merge equivalent states of a loaded machine and renumber them densely,
+ * the start state is still 0
+ * Return 0 on success, else -1
+ */
+int tm_minimize(struct machine*);
+
+#endif
+/*
+ * lockstep.h: Lockstep runs of deterministic machines
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <limits.h>
+
+#define LANES      16          /* Strings run at the same time */
+#define LANE_BATCH (4 * LANES) /* Strings queued before a run  */
+
+/* Rule from a state and a symbol column */
+struct lane_rule{
+    state         st;
+    symbol        ch;
+    signed char   mv;
+    char          flag;  /* 0: no rule, 1: rule, 2: rule to accepting state */
+    signed char   run;   /* Runaway direction, see macro.c                 */
+    struct macro *macro; /* Macro step from this rule, see macro.c         */
+};
+
+struct lanes{
+    struct lane_rule *rule;                /* States times columns     */
+    size_t            size,
+                      nsym;                /* 0 if machine not flat    */
+    unsigned char     sym[1 << CHAR_BIT];  /* Column of each symbol,   */
+    struct tmconf    *c[LANE_BATCH];       /* 0 if no rule reads it    */
+    int               out[LANE_BATCH];
+    size_t            n;
+};
+
+/*
+ * Flatten the rules of a loaded machine if it is deterministic,
+ * reusing the lanes of the previous one
+ * Return 0 on success, else -1
+ */
+int  lockstep_load(struct machine*);
+
+/* True if the loaded machine runs in lockstep */
+static inline int lockstep_ready(struct machine *tm){
+    return tm->lanes && tm->lanes->nsym;
+}
+
+/* Queue a starting configuration, return 1 if the batch is full */
+int  lockstep_put (struct machine*, struct tmconf*);
+/*
+ * Run the queued configurations, results are the same as tm_run
+ * Return the results in queue order and set n to their number,
+ * a result is -1 if memory ran out while running its string
+ */
+int *lockstep_run (struct machine*, size_t *n);
+void delete_lanes (struct lanes*);
+
+#endif
+/*
+ * profile.h: Run latency and hardware counters
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+/* Latency histogram with 2^PROF_SUB_BITS buckets per power of two */
+#define PROF_SUB_BITS 4
+#define PROF_BUCKETS  ((65 - PROF_SUB_BITS) << PROF_SUB_BITS)
+
+/* Hardware counters read around each run, where available */
+enum prof_event{
+    prof_cycles,
+    prof_instructions,
+    prof_cache_misses,
+    prof_branch_misses,
+    PROF_EVENTS
+};
+
+struct profile{
+    unsigned long      hist[PROF_BUCKETS]; /* Runs by latency bucket      */
+    unsigned long      n;                  /* Runs or batches timed       */
+    unsigned long      strings;            /* Strings in lockstep batches */
+    unsigned long long sum, max;           /* Latency in nanoseconds      */
+    unsigned long long count[PROF_EVENTS]; /* Counters summed over runs   */
+    int                fd[PROF_EVENTS];    /* Counter events, -1 if none  */
+    int                leader;             /* Group of the events, or -1  */
+    unsigned int       machine;            /* Summaries printed           */
+    unsigned long long t0;                 /* Start of the current run    */
+};
+
+/*
+ * Return a new profile, opening the hardware counters if permitted,
+ * else NULL
+ */
+struct profile *new_profile   ();
+
+/*
+ * Time a run and count events from start to stop, batch is the number
+ * of strings run in lockstep, or 0 for a single run
+ */
+void            profile_start (struct profile*);
+void            profile_stop  (struct profile*, size_t batch);
+
+/*
+ * Print a summary of the runs since the last one, then clear them,
+ * latencies are per batch if strings were run in lockstep
+ */
+void            profile_print (struct profile*, FILE*);
+
+void            delete_profile(struct profile*);
+
+#endif
+/*
+ * accept.c:  Accept states set
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Accepting states are stored in a set with a function
+ * to know if a state is an accepting state or not.
+ * The set is a hash table with open addressing: each state is stored
+ * in the first empty slot from its hash on, so it takes a few probes
+ * at most to find it or an empty slot, whatever the state values are.
+ * Hash table grows twice larger when it is 1/2 full.
+ * Empty slots are zeroes, so state 0 is stored apart.
+ *
+ *   hash(s)
+ *      v
+ * [ 0 | 7 | 3 | 0 | 0 | 12 | 0 | 0 ]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SET_MINSZ  8
+#define SET_MINBIT 3  /* log2(SET_MINSZ) */
+
+struct set{
+    state  *slot;
+    size_t  size,
+            count;
+    int     shift; /* 32 - log2(size), to keep the high bits of the hash */
+    int     zero;  /* True if 0 is in the set                            */
+};
+
+/* Slot of st, or empty slot where it would be stored */
+state *set_slot(state *slot, size_t size, int shift, state st);
+/* Return 0 on success, else -1 */
+int    set_grow(set*);
+
+/******************** Set ********************/
+
+set *new_set(){
+    set *s    = malloc(sizeof(*s));
+    if(!s) return NULL;
+    s->slot   = calloc(SET_MINSZ, sizeof(*s->slot));
+    if(!s->slot){
+        free(s);
+        return NULL;
+    }
+    s->size   = SET_MINSZ;
+    s->shift  = 32 - SET_MINBIT;
+    s->count  =
+    s->zero   = 0;
+    return s;
+}
+
+int set_put(set *s, state st){
+    state *t;
+    if(!st)
+        return s->zero = 1;
+    if(*(t = set_slot(s->slot, s->size, s->shift, st)))
+        return 1;
+    *t = st;
+    if(++s->count > s->size / 2 && set_grow(s))
+        return 0;
+    return 1;
+}
+
+int set_get(set *s, state st){
+    if(!st)
+        return s->zero;
+    return !!*set_slot(s->slot, s->size, s->shift, st);
+}
+
+void set_reset(set *s){
+    memset(s->slot, 0, s->size * sizeof(*s->slot));
+    s->count =
+    s->zero  = 0;
+}
+
+int set_grow(set *s){
+    state *slot = calloc(s->size * 2, sizeof(*slot));
+    size_t i;
+    if(!slot)
+        return -1;
+    for(i = 0; i < s->size; i++)
+        if(s->slot[i])
+            *set_slot(slot, s->size * 2, s->shift - 1, s->slot[i]) =
+                s->slot[i];
+    free(s->slot);
+    s->slot  = slot;
+    s->size *= 2;
+    s->shift--;
+    return 0;
+}
+
+/*
+ * Fibonacci hashing, size is a power of 2: the high bits of the 32 bit
+ * product depend on all the bits of st, the low ones only on its low bits
+ */
+state *set_slot(state *slot, size_t size, int shift, state st){
+    size_t i;
+    for(i = ((st * 2654435769u) & 0xffffffffu) >> shift;
+        slot[i] && slot[i] != st;
+        i = (i + 1) & (size - 1));
+    return slot + i;
+}
+
+void delete_set(set *s){
+    free(s->slot);
+    free(s);
+}
+/*
+ * bits.c:    Bitfield
+ *
+ * Author:    Giorgio Pristia
+ */
+
+
+char *bits_set(char *bits, size_t i){
+    bits[i >> 3] |= 1 << (i & 7);
+    return bits;
+}
+
+char *bits_unset(char *bits, size_t i){
+    bits[i >> 3] &= ~(1 << (i & 7));
+    return bits;
+}
+
+int bits_get(char *bits, size_t i){
+    return !!(bits[i >> 3] & 1 << (i & 7));
+}
+
+size_t bits_next_avail(char *bits, size_t len, size_t start){
+    size_t i, n;
+    for(i = start >> 3, n = start & 7; i < BYTES(len); i++, n = 0)
+        if(bits[i] != -1)
+            for(;(                        /* for each bit in byte          */
+                    !(len & 7)         ||
+                    i < BYTES(len) - 1 || /* if last byte, the bits beyond */
+                    n < (len & 7)         /* group len % 8 do not count    */
+               ) && n < 8; n++)
+                if (!(bits[i] >> n & 1))  /* if bit is 0, i.e. available,  */
+                    return (i << 3) + n;  /* return its index in bitfield  */
+    return len;
+}
+/*
+ * core.c:    Turing machine core
+ *
+ * Author:    Giorgio Pristia
+ *
+ * BFS, DFS and best-first search share the same loop and differ only in
+ * the frontier storing the configurations still to be expanded.
+ * A configuration of the frontier is a tape with a set of states: the
+ * destinations of all its states are grouped by symbol written and move,
+ * and the tape is copied only once per group, so branches that write
+ * and move the same way are kept on one tape instead of one each.
+ * Rules with two destinations writing and moving the same way are flagged
+ * when the machine is loaded: a single state with no such rule has
+ * nothing to group, so its tape is copied once per destination.
+ * Iterative deepening runs a depth-first search on a single tape,
+ * undoing each transition when backtracking, with a depth limit that
+ * doubles after each iteration until it reaches max moves, so memory is
+ * linear in max. It starts from the first state of the configuration.
+ * As a branch is non terminating only if it goes over max moves, every
+ * strategy gives the same result.
+ * When the machine is loaded its states are minimized, see minimize.c.
+ * Before each step, the macro steps found when the machine is loaded
+ * are taken at once, and branches running away on blanks past the end
+ * of the tape are non terminating without being stepped, see macro.c.
+ */
+
+#include <stdlib.h>
+
+#define IDDFS_MINDEPTH 16
+#define TM_STEP_MIN    16
+#define TM_STEP_ISORT  16 /* Insertion sort up to this many steps */
+
+/* Destination of one of the states of a configuration being expanded */
+struct tm_step{
+    symbol      ch;
+    signed char mv;
+    state       st;
+};
+
+/* Frontier functions for each search strategy */
+typedef void          *front_new_funct(void);
+typedef int            front_put_funct(struct machine*, void*, struct tmconf*);
+typedef struct tmconf *front_get_funct(void*);
+typedef void           front_del_funct(void*);
+front_put_funct front_enqueue, front_push, front_heap_push;
+front_get_funct front_dequeue;
+front_new_funct * const f_front_new[] =
+    {(front_new_funct*)new_queue, (front_new_funct*)new_queue,
+     NULL,                        (front_new_funct*)new_heap};
+front_put_funct * const f_front_put[] =
+    {front_enqueue, front_push, NULL, front_heap_push};
+front_get_funct * const f_front_get[] =
+    {front_dequeue, front_dequeue, NULL, (front_get_funct*)heap_pop};
+front_del_funct * const f_front_del[] =
+    {(front_del_funct*)delete_queue, (front_del_funct*)delete_queue,
+     NULL,                           (front_del_funct*)delete_heap};
+
+int tm_search(struct machine*, struct tmconf*);
+int tm_iddfs (struct machine*, struct tmconf*);
+
+/*
+ * Take macro steps from configuration c while possible, r is the rule
+ * from c and is updated to the rule from the configuration reached
+ * Return  0: on success
+ *         2: non terminating
+ *        -1: memory error
+ */
+int tm_macro (struct machine*, struct tmconf *c, rule_list **r);
+
+/*
+ * Mark the destinations reaching an accepting state
+ * and the rules whose destinations can share a tape
+ */
+void tm_mark (struct machine*);
+
+/*
+ * Expand configuration c of a single state, whose rule r has no
+ * destinations to group, adding to n the configurations put in q
+ * Return  0: on success
+ *         1: accept
+ *         2: non terminating
+ *        -1: memory error
+ */
+int tm_branch(struct machine*, void *q, struct tmconf *c, rule_list *r,
+              unsigned long *n);
+
+/* Sort steps by symbol written, move and state */
+void tm_step_sort(struct tm_step*, size_t n);
+int  tm_step_cmp (const void*, const void*);
+
+/* Double the room for steps, return 0 on success, else -1 */
+int  tm_step_grow(struct machine*);
+
+/******************** Machine ********************/
+
+int tm_run(struct machine *tm, struct tmconf *c){
+    int o;
+    tm->stats.runs++;
+    if(tm->prof)
+        profile_start(tm->prof);
+    if(tm->strategy == search_iddfs)
+        o = tm_iddfs(tm, c);
+    else
+        o = tm_search(tm, c);
+    if(tm->prof)
+        profile_stop(tm->prof, 0);
+    return o;
+}
+
+int tm_init(struct machine *tm){
+    tm->rules = new_rule_dict();
+    if(!tm->rules)
+        return -1;
+    tm->accept = new_set();
+    if(!tm->accept){
+        free(tm->rules);
+        return -1;
+    }
+    tm->max      = 0;
+    tm->strategy = search_bfs;
+    tm->h        = &h_accept_dist;
+    tm->macros   = NULL;
+    tm->lockstep = 0;
+    tm->lanes    = NULL;
+    tm->step     = NULL;
+    tm->nstep    = 0;
+    tm->prof     = NULL;
+    tm->stats    = (struct tm_stats){0};
+    return 0;
+}
+
+int tm_load(struct machine *tm){
+    if(tm_minimize(tm))
+        return -1;
+    tm_mark(tm);
+    if(macro_load(tm) || (tm->lockstep && lockstep_load(tm)))
+        return -1;
+    if(tm->strategy == search_best && tm->h->load)
+        return tm->h->load(tm);
+    return 0;
+}
+
+void tm_reset(struct machine *tm){
+    rule_dict_reset(tm->rules);
+    set_reset(tm->accept);
+    tm->max = 0;
+}
+
+void tm_mark(struct machine *tm){
+    rule_list *l;
+    rule_dest *d, *e;
+    size_t     i;
+    for(i = 0; i < tm->rules->size; i++)
+        for(l = tm->rules->rule[i]; l; l = l->next){
+            l->share = 0;
+            for(d = l->dest; d; d = d->next){
+                d->acc = set_get(tm->accept, d->st);
+                for(e = d->next; e && !l->share; e = e->next)
+                    l->share = e->ch == d->ch && e->mv == d->mv;
+            }
+        }
+}
+
+void tm_destroy(struct machine *tm){
+    delete_rule_dict(tm->rules);
+    delete_set(tm->accept);
+    delete_macro(tm->macros);
+    delete_lanes(tm->lanes);
+    free(tm->step);
+    delete_profile(tm->prof);
+}
+
+/******************** Frontier search ********************/
+
+int tm_search(struct machine *tm, struct tmconf *c){
+    rule_list *r;
+    rule_dest *d;
+    struct tmconf  *c_;
+    struct tm_step *s;
+    symbol ch;
+    size_t i, j, k, u;
+    unsigned int ttl;
+    int o = 0, m, live;
+    unsigned long n = 1; /* Configurations in the frontier */
+    front_put_funct *put = f_front_put[tm->strategy];
+    front_get_funct *get = f_front_get[tm->strategy];
+    void *q = f_front_new[tm->strategy]();
+    if(!q || put(tm, q, c)){
+        if(q) f_front_del[tm->strategy](q);
+        delete_tmconf(c);
+        return -1;
+    }
+    /* Loop until reache accept state or frontier is empty */
+    while(!(o & 1) && (c = get(q))){
+        if(n-- > tm->stats.peak)
+            tm->stats.peak = n + 1;
+        /* Macro steps only for a single state, as they move the tape */
+        r = c->n == 1 ?
+            rule_dict_lookup(tm->rules, c->st[0], tape_read(c->t)) : NULL;
+        if(r && r->macro && c->ttl && (m = tm_macro(tm, c, &r))){
+            delete_tmconf(c);  /* Non terminating branch or memory error */
+            o = m;
+            continue;
+        }
+        /* Nothing to group: branch once per destination */
+        if(c->n == 1 && !(r && r->share)){
+            if((m = tm_branch(tm, q, c, r, &n)))
+                o = m;
+            continue;
+        }
+        /* Outgoing transitions from each state of the configuration */
+        ch = tape_read(c->t);
+        for(i = k = 0, live = 0; i < c->n && !(o & 1); i++){
+            if(c->n > 1)
+                r = rule_dict_lookup(tm->rules, c->st[i], ch);
+            if(!r || !r->dest) /* No outgoing transitions: dead state     */
+                continue;
+            if(r->runaway && tape_edge(c->t, r->runaway)){
+                tm->stats.runaway++;
+                o = 2;         /* Running away on blanks forever          */
+                continue;
+            }
+            live = 1;
+            if(!c->ttl)
+                continue;
+            for(d = r->dest; d; d = d->next){
+                if(d->acc){    /* As soon as an accepting state is */
+                    o = 1;     /* reached, TM stops and returns 1  */
+                    break;
+                }
+                if(k == tm->nstep && tm_step_grow(tm)){
+                    o = -1;
+                    break;
+                }
+                tm->step[k++] = (struct tm_step){d->ch, d->mv, d->st};
+            }
+        }
+        if(live && !c->ttl)    /* There are outgoing transitions but time */
+            o = 2;             /* to live is zero: non terminating branch */
+        if(o & 1 || !k){
+            delete_tmconf(c);
+            continue;
+        }
+        tm->stats.expanded++;
+        tm_step_sort(tm->step, k);
+        ttl = c->ttl - 1;
+        for(i = 0, s = tm->step; i < k; i = j){
+            /* States reached writing and moving the same way share a tape */
+            for(j = i + 1, u = 1; j < k && s[j].ch == s[i].ch &&
+                                  s[j].mv == s[i].mv; j++)
+                u += s[j].st != s[j - 1].st;
+            if(j < k){
+                if(!(c_ = new_tmconf(u)) || !(c_->t = tape_branch(c->t))){
+                    free(c_);
+                    delete_tmconf(c);
+                    o = -1;
+                    break;
+                }
+                tm->stats.branched++;  /* Branch current configuration */
+            }
+            /* Last group is applied inplace without branching */
+            else if(!(c_ = tmconf_resize(c, u))){
+                delete_tmconf(c);
+                o = -1;
+                break;
+            }
+            /* Apply transition and put the configuration reached */
+            for(c_->n = 0; i < j; i++)
+                if(!c_->n || c_->st[c_->n - 1] != s[i].st)
+                    c_->st[c_->n++] = s[i].st;
+            tm->stats.shared += u - 1;
+            c_->ttl = ttl;
+            tape_write(c_->t, s[j - 1].ch, s[j - 1].mv);
+            if(put(tm, q, c_)){
+                delete_tmconf(c_);
+                if(j < k)
+                    delete_tmconf(c);
+                o = -1;
+                break;
+            }
+            n++;
+        }
+    }
+    /* Clear all remaining configurations and return */
+    f_front_del[tm->strategy](q);
+    return o;
+}
+
+int tm_branch(struct machine *tm, void *q, struct tmconf *c, rule_list *r,
+              unsigned long *n){
+    rule_dest     *d = r ? r->dest : NULL;
+    struct tmconf *c_;
+    if(!d){                /* No outgoing transitions: dead branch    */
+        delete_tmconf(c);
+        return 0;
+    }
+    if(r->runaway && tape_edge(c->t, r->runaway)){
+        delete_tmconf(c);  /* Running away on blanks forever          */
+        tm->stats.runaway++;
+        return 2;
+    }
+    if(!c->ttl){           /* There are outgoing transitions but time */
+        delete_tmconf(c);  /* to live is zero: non terminating branch */
+        return 2;
+    }
+    for(tm->stats.expanded++; d; d = d->next){
+        if(d->acc){
+            delete_tmconf(c); /* As soon as an accepting state is */
+            return 1;         /* reached, TM stops and returns 1  */
+        }
+        if(d->next){
+            if(!(c_ = new_tmconf(1)) || !(c_->t = tape_branch(c->t))){
+                free(c_);
+                delete_tmconf(c);
+                return -1;
+            }
+            c_->n = 1;
+            tm->stats.branched++;  /* Branch current configuration */
+        }
+        else /* Last transition is applied inplace without branching   */
+            c_ = c;
+        /* Apply transition and put the configuration reached */
+        c_->st[0] = d->st;
+        c_->ttl   = c->ttl - 1;
+        tape_write(c_->t, d->ch, d->mv);
+        if(f_front_put[tm->strategy](tm, q, c_)){
+            delete_tmconf(c_);
+            if(c_ != c)
+                delete_tmconf(c);
+            return -1;
+        }
+        (*n)++;
+    }
+    return 0;
+}
+
+int tm_step_cmp(const void *a, const void *b){
+    const struct tm_step *x = a, *y = b;
+    if(x->ch != y->ch)
+        return (x->ch > y->ch) - (x->ch < y->ch);
+    if(x->mv != y->mv)
+        return (x->mv > y->mv) - (x->mv < y->mv);
+    return (x->st > y->st) - (x->st < y->st);
+}
+
+void tm_step_sort(struct tm_step *s, size_t n){
+    struct tm_step t;
+    size_t i, j;
+    if(n > TM_STEP_ISORT){
+        qsort(s, n, sizeof(*s), tm_step_cmp);
+        return;
+    }
+    for(i = 1; i < n; i++){
+        for(t = s[i], j = i; j && tm_step_cmp(&t, s + j - 1) < 0; j--)
+            s[j] = s[j - 1];
+        s[j] = t;
+    }
+}
+
+int tm_step_grow(struct machine *tm){
+    size_t n = tm->nstep ? tm->nstep * 2 : TM_STEP_MIN;
+    struct tm_step *t = realloc(tm->step, n * sizeof(*t));
+    if(!t)
+        return -1;
+    tm->step  = t;
+    tm->nstep = n;
+    return 0;
+}
+
+int front_enqueue(struct machine *tm, void *q, struct tmconf *c){
+    (void)tm;
+    enqueue(q, c);
+    return 0;
+}
+
+int front_push(struct machine *tm, void *q, struct tmconf *c){
+    (void)tm;
+    push(q, c);
+    return 0;
+}
+
+int front_heap_push(struct machine *tm, void *h, struct tmconf *c){
+    return heap_push(h, tm->h->eval(tm, c), c);
+}
+
+struct tmconf *front_dequeue(void *q){
+    return dequeue(q);
+}
+
+int tm_macro(struct machine *tm, struct tmconf *c, rule_list **r){
+    unsigned long n;
+    for(; *r && (*r)->macro && c->ttl;
+        *r = rule_dict_lookup(tm->rules, c->st[0], tape_read(c->t))){
+        if((n = macro_len((*r)->macro, c->t, c->ttl)) > c->ttl)
+            return 2;
+        if(!macro_apply((*r)->macro, c->st, c->t, n))
+            return -1;
+        c->ttl -= n;
+        tm->stats.macro += n;
+    }
+    return 0;
+}
+
+/******************** Iterative deepening ********************/
+
+/* Transition applied at each depth, to be undone on backtrack */
+struct iddfs_frame{
+    rule_dest   *d;    /* NULL for a macro step                         */
+    state        st;   /* State, symbol and head before the transition  */
+    symbol       ch;
+    long         head;
+    unsigned int k;    /* Depth before the transition                   */
+};
+
+/* Return the frame at index i, growing the stack if needed, else NULL */
+struct iddfs_frame *iddfs_push(struct iddfs_frame **f, size_t *fsz,
+                               size_t i, unsigned int max){
+    struct iddfs_frame *t;
+    if(i == *fsz){
+        *fsz = *fsz ? *fsz * 2 : IDDFS_MINDEPTH;
+        if(*fsz > max)
+            *fsz = max;
+        if(!(t = realloc(*f, *fsz * sizeof(**f))))
+            return NULL;
+        *f = t;
+    }
+    return *f + i;
+}
+
+int tm_iddfs(struct machine *tm, struct tmconf *c){
+    struct iddfs_frame *f = NULL, *t = NULL;
+    rule_list    *r;
+    rule_dest    *d;
+    state         st;
+    tape         *tp  = c->t;
+    size_t        i, fsz = 0;
+    unsigned long n;
+    unsigned int  k, lim = c->ttl < IDDFS_MINDEPTH ? c->ttl : IDDFS_MINDEPTH;
+    int           o, cut;
+    for(;; lim = lim > c->ttl / 2 ? c->ttl : lim * 2){
+        o   = 0;
+        cut = 0;
+        st  = c->st[0];
+        k   = 0;
+        i   = 0;
+        for(;;){
+            /* Descend from configuration at depth k */
+            if((r = rule_dict_lookup(tm->rules, st, tape_read(tp)))){
+                if(k < lim && r->macro &&
+                   (n = macro_len(r->macro, tp, lim - k)) <= lim - k){
+                    if(!(t = iddfs_push(&f, &fsz, i++, c->ttl))){
+                        o = -1;
+                        break;
+                    }
+                    *t = (struct iddfs_frame){NULL, st, tape_read(tp),
+                                              tp->head, k};
+                    if(!macro_apply(r->macro, &st, tp, n)){
+                        o = -1;
+                        break;
+                    }
+                    k += n;
+                    tm->stats.macro += n;
+                    continue;
+                }
+                if(r->runaway && tape_edge(tp, r->runaway)){
+                    tm->stats.runaway++;
+                    o = 2;                /* Running away on blanks        */
+                }
+                else if(k == lim || r->macro){ /* Transitions beyond limit:*/
+                    if(lim == c->ttl)     /* non terminating if it is max  */
+                        o = 2;
+                    else                  /* else go deeper next iteration */
+                        cut = 1;
+                }
+                else{
+                    tm->stats.expanded++;
+                    for(d = r->dest; d; d = d->next)
+                        if(d->acc)
+                            break;
+                    if(d){            /* As soon as an accepting state is */
+                        o = 1;        /* reached, TM stops and returns 1  */
+                        break;
+                    }
+                    if(!(t = iddfs_push(&f, &fsz, i++, c->ttl))){
+                        o = -1;
+                        break;
+                    }
+                    *t = (struct iddfs_frame){r->dest, st, tape_read(tp),
+                                              tp->head, k++};
+                    if(k > tm->stats.peak)
+                        tm->stats.peak = k;
+                    st = t->d->st;
+                    tape_write(tp, t->d->ch, t->d->mv);
+                    continue;
+                }
+            }
+            /* Backtrack to the next untried transition */
+            for(; i; i--){
+                t = f + i - 1;
+                tp->head = t->head;
+                tape_write(tp, t->ch, 0);
+                st = t->st;
+                k  = t->k;
+                if(t->d && (t->d = t->d->next))
+                    break;
+            }
+            if(!i)
+                break;
+            st = t->d->st;
+            tape_write(tp, t->d->ch, t->d->mv);
+            k++;
+        }
+        /* Tree fully explored within the limit, or accepted */
+        if(o & 1 || !cut)
+            break;
+    }
+    free(f);
+    delete_tmconf(c);
+    return o;
+}
+/*
+ * heap.c:    Configuration priority queue
+ *
+ * Author:    Giorgio Pristia
+ *
+ * This binary min-heap is used to store configurations in best-first
+ * search, the key of each configuration is given by the heuristic.
+ * Nodes are stored in an array that grows twice larger when full.
+ *
+ *          0
+ *        /   \
+ *       1     2        children of n are 2n + 1 and 2n + 2
+ *      / \   / \
+ *     3   4 5   6
+ */
+
+#include <stdlib.h>
+
+#define HEAP_MINSZ 16
+
+heap *new_heap(){
+    heap *h = malloc(sizeof(*h));
+    if(!h)
+        return NULL;
+    h->node = malloc(HEAP_MINSZ * sizeof(*h->node));
+    if(!h->node){
+        free(h);
+        return NULL;
+    }
+    h->size  = HEAP_MINSZ;
+    h->count = 0;
+    return h;
+}
+
+int heap_push(heap *h, unsigned int key, struct tmconf *conf){
+    size_t i, p;
+    if(h->count == h->size){
+        struct heap_node *t = realloc(h->node, h->size * 2 * sizeof(*t));
+        if(!t)
+            return -1;
+        h->node  = t;
+        h->size *= 2;
+    }
+    /* Sift up the new node from the last position */
+    for(i = h->count++; i && h->node[p = (i - 1) / 2].key > key; i = p)
+        h->node[i] = h->node[p];
+    h->node[i].key  = key;
+    h->node[i].conf = conf;
+    return 0;
+}
+
+struct tmconf *heap_pop(heap *h){
+    size_t i, c;
+    if(!h->count)
+        return NULL;
+    struct tmconf   *conf = h->node->conf;
+    struct heap_node last = h->node[--h->count];
+    /* Sift down the last node from the root */
+    for(i = 0; (c = 2 * i + 1) < h->count; i = c){
+        if(c + 1 < h->count && h->node[c + 1].key < h->node[c].key)
+            c++;
+        if(last.key <= h->node[c].key)
+            break;
+        h->node[i] = h->node[c];
+    }
+    h->node[i] = last;
+    return conf;
+}
+
+void delete_heap(heap *h){
+    struct tmconf *conf;
+    while((conf = heap_pop(h)))
+        delete_tmconf(conf);
+    free(h->node);
+    free(h);
+}
+/*
+ * heuristic.c: Best-first search heuristics
+ *
+ * Author:    Giorgio Pristia
+ *
+ * The accept distance of a rule is the least number of transitions
+ * needed to reach an accepting state after reading its symbol,
+ * the distance of a state is the least distance among its rules.
+ * Once the machine is loaded, rules are indexed by destination state and
+ * distances are found breadth first, starting from the rules that reach
+ * an accepting state: the first rule of a state to be dequeued gives the
+ * state its distance, and every rule leading there is one step further.
+ * Rules that can not reach an accepting state are left at H_INF.
+ * A configuration is as close as the closest of its states.
+ *
+ * (state, symbol) => 1 + min(dist(dest state))  or 1 if dest accepts
+ */
+
+#include <stdlib.h>
+
+#define H_INF ((unsigned int)-1)
+
+h_load_funct h_accept_load;
+h_eval_funct h_accept_eval;
+
+const struct heuristic h_accept_dist = {h_accept_load, h_accept_eval};
+
+/* Rule r has a destination to state st */
+struct h_pred{
+    state      st;
+    rule_list *r;
+};
+
+int h_pred_cmp(const void *a, const void *b){
+    state x = ((const struct h_pred*)a)->st,
+          y = ((const struct h_pred*)b)->st;
+    return (x > y) - (x < y);
+}
+
+/* Index of the first predecessor of st, or n if none */
+size_t h_pred_find(struct h_pred *p, size_t n, state st){
+    size_t lo = 0, hi = n, m;
+    while(lo < hi){
+        m = lo + (hi - lo) / 2;
+        if(p[m].st < st) lo = m + 1;
+        else             hi = m;
+    }
+    return lo < n && p[lo].st == st ? lo : n;
+}
+
+int h_accept_load(struct machine *tm){
+    rule_dict     *dict = tm->rules;
+    rule_list    **q, *l;
+    rule_dest     *d;
+    struct h_pred *p;
+    size_t         i, j, n = 0, head = 0, tail = 0;
+    char          *done;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next)
+                n++;
+    if(!(p = malloc((n + 1) * sizeof(*p))))
+        return -1;
+    /* Queue of rules by distance, each rule enters it once */
+    if(!(q = malloc((dict->count + 1) * sizeof(*q)))){
+        free(p);
+        return -1;
+    }
+    /* Whether the predecessors of a state have been visited,
+     * stored at the index of its first predecessor */
+    if(!(done = calloc(n + 1, sizeof(*done)))){
+        free(q);
+        free(p);
+        return -1;
+    }
+    for(n = i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            l->dist = H_INF;
+            for(d = l->dest; d; d = d->next){
+                p[n].st  = d->st;
+                p[n++].r = l;
+                if(d->acc && l->dist == H_INF){
+                    l->dist   = 1;
+                    q[tail++] = l;
+                }
+            }
+        }
+    qsort(p, n, sizeof(*p), h_pred_cmp);
+    while(head < tail){
+        l = q[head++];
+        if((j = h_pred_find(p, n, l->st)) == n || done[j])
+            continue;
+        done[j] = 1;
+        for(; j < n && p[j].st == l->st; j++)
+            if(p[j].r->dist == H_INF){
+                p[j].r->dist = l->dist + 1;
+                q[tail++]    = p[j].r;
+            }
+    }
+    free(done);
+    free(q);
+    free(p);
+    return 0;
+}
+
+unsigned int h_accept_eval(struct machine *tm, struct tmconf *c){
+    rule_list   *r;
+    unsigned int v = H_INF;
+    size_t       i;
+    symbol       ch = tape_read(c->t);
+    for(i = 0; i < c->n; i++)
+        if((r = rule_dict_lookup(tm->rules, c->st[i], ch)) && r->dist < v)
+            v = r->dist;
+    return v;
+}
+/*
+ * lockstep.c: Lockstep runs of deterministic machines
+ *
+ * Author:    Giorgio Pristia
+ *
+ * When every rule of the machine has a single destination, rules are
+ * flattened in a table indexed by state and symbol column, states being
+ * dense once minimized. Queued strings are then run in lanes: each
+ * iteration steps every lane once, so the table lookups of different
+ * lanes do not depend on each other and can overlap.
+ * Lanes take the macro steps of their rules as tm_run does, so a sweep
+ * or a chain costs a lane a single iteration.
+ * A lane is retired as soon as its string accepts, rejects or runs out
+ * of moves, and takes the next queued string.
+ * As strings of a batch interleave, profiling times the whole batch.
+ *
+ *            st  col       st  col       st  col
+ * lane 0:  [ 3 | a ] ->  [ 4 | b ] ->  [ 4 | _ ] -> accept, next string
+ * lane 1:  [ 0 | b ] ->  [ 2 | b ] ->  [ 1 | a ] -> ...
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LANE_MAXRULES (1 << 20) /* Largest table, else run one by one */
+
+int lockstep_load(struct machine *tm){
+    rule_dict        *dict = tm->rules;
+    rule_list        *l;
+    struct lanes     *t    = tm->lanes;
+    struct lane_rule *r;
+    size_t            i, nst = 1, nsym = 1;
+    /* Lanes of the previous machine are reused */
+    if(t)
+        t->nsym = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            if(l->dest->next)   /* Non deterministic */
+                return 0;
+            if(l->st >= nst)      nst = l->st + 1;
+            if(l->dest->st >= nst) nst = l->dest->st + 1;
+        }
+    if(!t && !(t = tm->lanes = calloc(1, sizeof(*t))))
+        return -1;
+    memset(t->sym, 0, sizeof(t->sym));
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            if(!t->sym[(unsigned char)l->ch])
+                t->sym[(unsigned char)l->ch] = nsym++;
+    if(nst > LANE_MAXRULES / nsym)
+        return 0;
+    if(nst * nsym > t->size){
+        if(!(r = realloc(t->rule, nst * nsym * sizeof(*r))))
+            return -1;
+        t->rule = r;
+        t->size = nst * nsym;
+    }
+    memset(t->rule, 0, nst * nsym * sizeof(*t->rule));
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            t->rule[l->st * nsym + t->sym[(unsigned char)l->ch]] =
+                (struct lane_rule){l->dest->st, l->dest->ch, l->dest->mv,
+                                   1 + l->dest->acc, l->runaway, l->macro};
+    t->nsym = nsym;
+    return 0;
+}
+
+int lockstep_put(struct machine *tm, struct tmconf *c){
+    tm->lanes->c[tm->lanes->n++] = c;
+    return tm->lanes->n == LANE_BATCH;
+}
+
+int *lockstep_run(struct machine *tm, size_t *n){
+    struct lanes     *t = tm->lanes;
+    struct lane_rule  r;
+    tape             *tp [LANES];
+    state             st [LANES];
+    unsigned int      ttl[LANES];
+    size_t            c  [LANES], i, live = 0, next = 0;
+    unsigned long     steps = 0, macro = 0, m;
+    if(!t->n){
+        *n = 0;
+        return t->out;
+    }
+    if(tm->prof)
+        profile_start(tm->prof);
+    for(; live < LANES && next < t->n; live++, next++){
+        c[live]   = next;
+        tp[live]  = t->c[next]->t;
+        st[live]  = t->c[next]->st[0];
+        ttl[live] = t->c[next]->ttl;
+    }
+    while(live){
+        for(i = 0; i < live;){
+            r = t->rule[st[i] * t->nsym +
+                        t->sym[(unsigned char)tape_read(tp[i])]];
+            if(r.flag == 1 && ttl[i] && r.macro){
+                if((m = macro_len(r.macro, tp[i], ttl[i])) <= ttl[i] &&
+                   macro_apply(r.macro, &st[i], tp[i], m)){
+                    ttl[i] -= m;
+                    macro  += m;
+                    i++;
+                    continue;
+                }
+                /* Non terminating macro or memory error */
+                t->out[c[i]] = m > ttl[i] ? 2 : -1;
+            }
+            else if(r.flag == 1 && ttl[i] &&
+                    !(r.run && tape_edge(tp[i], r.run))){
+                tape_write(tp[i], r.ch, r.mv);
+                st[i] = r.st;
+                ttl[i]--;
+                steps++;
+                i++;
+                continue;
+            }
+            else{
+                /* Retire the lane, same checks as tm_run */
+                t->out[c[i]] = !r.flag ? 0 : r.flag == 1 || !ttl[i] ? 2 : 1;
+                if(r.flag == 2 && ttl[i])
+                    steps++;
+            }
+            delete_tmconf(t->c[c[i]]);
+            if(next < t->n){
+                c[i]   = next;
+                tp[i]  = t->c[next]->t;
+                st[i]  = t->c[next]->st[0];
+                ttl[i] = t->c[next]->ttl;
+                next++;
+            }
+            else{
+                live--;
+                c[i]   = c[live];
+                tp[i]  = tp[live];
+                st[i]  = st[live];
+                ttl[i] = ttl[live];
+            }
+        }
+    }
+    if(tm->prof)
+        profile_stop(tm->prof, t->n);
+    tm->stats.runs     += t->n;
+    tm->stats.lockstep += t->n;
+    tm->stats.expanded += steps;
+    tm->stats.macro    += macro;
+    *n   = t->n;
+    t->n = 0;
+    return t->out;
+}
+
+void delete_lanes(struct lanes *t){
+    if(!t)
+        return;
+    while(t->n)
+        delete_tmconf(t->c[--t->n]);
+    free(t->rule);
+    free(t);
+}
+/*
+ * macro.c:   Macro steps
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Once the machine is loaded its rules are scanned for runs of
+ * steps that can be taken at once, without a trip through the main loop.
+ * Every step of a macro is deterministic and never reaches an accepting
+ * state, so it is equivalent to take all of them decreasing time to live
+ * by the number of steps.
+ *
+ * A sweep is made of the rules of a state that leave the symbol and the
+ * state unchanged and move the same way, e.g. 1 a a R 1 and 1 b b R 1:
+ * the head moves until a symbol not in the sweep is found, which can
+ * be counted scanning the tape, a word at a time for a single symbol or
+ * looking each cell up in a table of the swept symbols. A sweep over
+ * blanks never ends past the end of the tape.
+ *
+ * A chain is a sequence of deterministic S rules, each one reading the
+ * symbol written by the previous one: only the last state and symbol
+ * matter. If the chain comes back to one of its rules it never ends.
+ *
+ * A runaway is a cycle of deterministic rules reading blank and moving
+ * the same way, e.g. 5 _ a R 6 and 6 _ _ R 5: once the head is on the
+ * last cell of the tape in that direction it only reads blanks, so the
+ * branch never ends, whatever it writes behind.
+ *
+ * Chains and runaways are walked once: the rules met on the way are kept
+ * on a stack, then each one takes the result of the rest of the walk.
+ *
+ * (1, a) => sweep R {a, b}           (2, a) => chain 3 steps: (5, c)
+ * (5, _) => runaway R
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SET_SIZE  (1 << CHAR_BIT)
+#define RUN_TODO  2 /* Runaway of the rule not found yet */
+#define RUN_WALK  3 /* Rule on the walk in progress      */
+
+/* Take a macro from the pool or allocate it, and add it to the machine */
+struct macro *macro_new(struct machine*, struct macro **pool);
+
+/*
+ * Give a macro to each rule starting a chain of at least two,
+ * stk has room for all the rules
+ * Return 0 on success, else -1
+ */
+int  macro_chains  (struct machine*, struct macro **pool, rule_list **stk);
+/* Set the direction of the runaway from each blank rule, 0 if none */
+void macro_runaways(rule_dict*, rule_list **stk);
+
+int macro_is_sweep(rule_list*);
+int macro_is_stay (rule_list*);
+int macro_sweep_cmp(const void*, const void*);
+
+int macro_load(struct machine *tm){
+    rule_dict    *dict = tm->rules;
+    rule_list   **r, *l;
+    struct macro *m = NULL, *pool = tm->macros;
+    size_t        i, n = 0;
+    /* Macros of the previous machine are reused */
+    tm->macros = NULL;
+    if(!(r = malloc((dict->count + 1) * sizeof(*r)))){
+        delete_macro(pool);
+        return -1;
+    }
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            l->macro = NULL;
+            if(macro_is_sweep(l))
+                r[n++] = l;
+        }
+    /* Sweeps, a macro for each state and direction */
+    qsort(r, n, sizeof(*r), macro_sweep_cmp);
+    for(i = 0; i < n; i++){
+        if(!i || macro_sweep_cmp(r + i - 1, r + i)){
+            if(!(m = macro_new(tm, &pool)) || (!m->set &&
+               !(m->set = malloc(SET_SIZE * sizeof(*m->set))))){
+                delete_macro(pool);
+                free(r);
+                return -1;
+            }
+            memset(m->set, 0, SET_SIZE * sizeof(*m->set));
+            m->type    = macro_sweep;
+            m->mv      = r[i]->dest->mv;
+            m->ch      = r[i]->ch;
+        }
+        m->len++;
+        m->set[(unsigned char)r[i]->ch] = 1;
+        r[i]->macro = m;
+    }
+    /* Chains, then runaways, using r as stack */
+    if(macro_chains(tm, &pool, r)){
+        delete_macro(pool);
+        free(r);
+        return -1;
+    }
+    macro_runaways(dict, r);
+    delete_macro(pool);
+    free(r);
+    return 0;
+}
+
+struct macro *macro_new(struct machine *tm, struct macro **pool){
+    struct macro *m;
+    if((m = *pool))
+        *pool = m->next;
+    else if(!(m = calloc(1, sizeof(*m))))
+        return NULL;
+    m->len     = 0;
+    m->next    = tm->macros;
+    tm->macros = m;
+    return m;
+}
+
+unsigned long macro_len(struct macro *m, tape *t, unsigned int max){
+    switch(m->type){
+        case macro_sweep:
+            return tape_span(t, m->mv, m->ch, m->len > 1 ? m->set : NULL,
+                             max + 1ul);
+        case macro_chain:
+            return m->len > max ? max + 1ul : m->len;
+        default:
+            return max + 1ul;
+    }
+}
+
+tape *macro_apply(struct macro *m, state *st, tape *t, unsigned long n){
+    if(m->type == macro_sweep)
+        return tape_skip(t, n, m->mv);
+    *st = m->st;
+    return tape_write(t, m->ch, 0);
+}
+
+void delete_macro(struct macro *m){
+    struct macro *t;
+    while(m){
+        t = m->next;
+        free(m->set);
+        free(m);
+        m = t;
+    }
+}
+
+/******************** Rule classification ********************/
+
+int macro_chains(struct machine *tm, struct macro **pool, rule_list **stk){
+    rule_dict    *dict = tm->rules;
+    rule_list    *l, *s;
+    struct macro *m;
+    size_t        i, n;
+    unsigned int  len = 0;
+    state         st  = 0;
+    symbol        ch  = 0;
+    int           loop;
+    /* Rules on the walk are marked by runaway, which is set afterwards */
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            l->runaway = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            /* Walk to the end, to a rule already done or back on the walk */
+            for(n = 0, s = l; s && macro_is_stay(s) && !s->macro &&
+                              !s->runaway;
+                s = rule_dict_lookup(dict, s->dest->st, s->dest->ch)){
+                s->runaway = 1;
+                stk[n++]   = s;
+            }
+            if(!n)
+                continue;
+            loop = 0;
+            len  = 0;
+            if(s && macro_is_stay(s)){
+                if(s->runaway || s->macro->type == macro_loop)
+                    loop = 1;
+                else{
+                    len = s->macro->len;
+                    st  = s->macro->st;
+                    ch  = s->macro->ch;
+                }
+            }
+            /* Each rule takes the rest of the chain plus itself */
+            while(n--){
+                s = stk[n];
+                s->runaway = 0;
+                if(!len && !loop){
+                    st = s->dest->st;
+                    ch = s->dest->ch;
+                }
+                if(++len < 2 && !loop)
+                    continue;
+                if(!(m = macro_new(tm, pool)))
+                    return -1;
+                m->type  = loop ? macro_loop : macro_chain;
+                m->st    = st;
+                m->ch    = ch;
+                m->len   = len;
+                s->macro = m;
+            }
+        }
+    return 0;
+}
+
+void macro_runaways(rule_dict *dict, rule_list **stk){
+    rule_list *l, *s;
+    rule_dest *d;
+    size_t     i, n;
+    int        mv, run;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            l->runaway = l->ch ? 0 : RUN_TODO;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            if(l->runaway != RUN_TODO)
+                continue;
+            /* Walk deterministic blank rules moving the same way */
+            mv = l->dest->mv;
+            for(n = 0, s = l; s && s->runaway == RUN_TODO;
+                s = rule_dict_lookup(dict, d->st, 0)){
+                d = s->dest;
+                if(d->next || d->acc || !mv || d->mv != mv)
+                    break;
+                s->runaway = RUN_WALK;
+                stk[n++]   = s;
+            }
+            /* A cycle, or a rule already known to run away the same way */
+            run = s && (s->runaway == RUN_WALK || s->runaway == mv) ? mv : 0;
+            if(!n)
+                l->runaway = 0;
+            while(n--)
+                stk[n]->runaway = run;
+        }
+}
+
+int macro_is_sweep(rule_list *r){
+    rule_dest *d = r->dest;
+    return !d->next && d->mv && d->st == r->st && d->ch == r->ch &&
+           !d->acc;
+}
+
+int macro_is_stay(rule_list *r){
+    rule_dest *d = r->dest;
+    return !d->next && !d->mv && !d->acc;
+}
+
+int macro_sweep_cmp(const void *a, const void *b){
+    rule_list *x = *(rule_list* const*)a,
+              *y = *(rule_list* const*)b;
+    if(x->st != y->st)
+        return (x->st > y->st) - (x->st < y->st);
+    return x->dest->mv - y->dest->mv;
+}
+/*
+ * minimize.c: Machine state minimization
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Two states are equivalent when, for every symbol read, they have the
+ * same transitions writing the same symbol, moving the same way and
+ * reaching equivalent states: a run from either of them gives the same
+ * result. States are first split in accepting and not accepting, then
+ * each class is split by the transitions of its states, with destinations
+ * replaced by their class, until no class is split anymore.
+ * Accepting states stop the machine as soon as they are reached, so their
+ * transitions are ignored, except for the start state which is never
+ * checked for acceptance. The rules are then rebuilt with a state for
+ * each class, numbered in order of their smallest state, so the start
+ * state is still 0.
+ *
+ * 0 a a R 1    0 b b R 2                  0 a a R 1    0 b b R 1
+ * 1 a a R 3    2 a a R 4    acc 3 4  =>   1 a a R 2    acc 2
+ */
+
+#include <stdlib.h>
+
+/* Transition from a state, with destination as index and class */
+struct min_edge{
+    symbol        ch_from,
+                  ch_dest;
+    int           mv;
+    size_t        dest;
+    unsigned int  cls;
+};
+
+/*
+ * Transitions of a state are sorted by symbols, move and class,
+ * so that transitions to the same class are next to each other
+ * and count as one
+ */
+struct min_state{
+    state              st;
+    unsigned int       cls;
+    struct min_edge   *e;
+    size_t             len;
+    int                acc;
+    size_t             pos;   /* Index in the partition                   */
+    struct min_state **pred;  /* States with transitions to this one      */
+    size_t             npred;
+    char               touch, /* Class to be checked against its own      */
+                       queue; /* Class changed, predecessors to be touched */
+};
+
+/* A class is a range of the partition, touched states at its end */
+struct min_class{
+    size_t first,
+           end,
+           ntouch;
+};
+
+/* Arrays used by the minimization, sized by the number of rules */
+struct min_work{
+    struct rule       *r;
+    struct min_edge   *e;
+    struct min_state  *s;
+    struct min_state **p,     /* Partition, states grouped by class        */
+                     **w,     /* States whose class changed                */
+                     **b,     /* States whose predecessors are touched now */
+                     **pred;
+    struct min_class  *c;
+    unsigned int      *dirty; /* Classes with touched states               */
+};
+
+/* Return 0 on success, else -1 */
+int    min_refine    (struct machine*, struct min_work*, size_t nr);
+/* Split classes until their states have the same transitions, return ncls */
+unsigned int min_split(struct min_work*, size_t ns);
+/* Move a state to the touched states at the end of its class */
+void   min_touch     (struct min_work*, struct min_state*, size_t *nd);
+/* Sort the transitions of a state by class of their destination */
+void   min_sign      (struct min_state *s, struct min_state*);
+/* End of the group of states starting at i, states before g are one group */
+size_t min_group     (struct min_state**, size_t i, size_t g, size_t e);
+/* Move p[j, k) before p[i, j) */
+void   min_rotate    (struct min_state**, size_t i, size_t j, size_t k);
+void   min_reverse   (struct min_state**, size_t i, size_t j);
+size_t min_state_find(struct min_state*, size_t n, state);
+/* Index of the next transition to a different class after i */
+size_t min_edge_next (struct min_state*, size_t i);
+int    min_st_cmp    (const void*, const void*);
+int    min_sig_cmp   (const void*, const void*);
+int    min_edge_cmp  (const void*, const void*);
+int    min_rule_cmp  (const void*, const void*);
+
+int tm_minimize(struct machine *tm){
+    rule_dict         *dict = tm->rules;
+    rule_list         *l;
+    rule_dest         *d;
+    size_t             i, nr = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next)
+                nr++;
+    /*
+     * Each rule uses at most two states, plus the start state,
+     * and there can be two more classes left empty at first
+     */
+    struct min_work w = {
+        malloc((nr + 1)     * sizeof(*w.r)),
+        malloc((nr + 1)     * sizeof(*w.e)),
+        malloc((2 * nr + 1) * sizeof(*w.s)),
+        malloc((2 * nr + 1) * sizeof(*w.p)),
+        malloc((2 * nr + 1) * sizeof(*w.w)),
+        malloc((2 * nr + 1) * sizeof(*w.b)),
+        malloc((nr + 1)     * sizeof(*w.pred)),
+        malloc((2 * nr + 3) * sizeof(*w.c)),
+        malloc((2 * nr + 3) * sizeof(*w.dirty))
+    };
+    int o = w.r && w.e && w.s && w.p && w.w && w.b && w.pred && w.c &&
+            w.dirty ? min_refine(tm, &w, nr) : -1;
+    free(w.dirty);
+    free(w.c);
+    free(w.pred);
+    free(w.b);
+    free(w.w);
+    free(w.p);
+    free(w.s);
+    free(w.e);
+    free(w.r);
+    return o;
+}
+
+int min_refine(struct machine *tm, struct min_work *w, size_t nr){
+    rule_dict        *dict = tm->rules;
+    rule_list        *l;
+    rule_dest        *d;
+    struct rule      *r = w->r;
+    struct min_edge  *e = w->e;
+    struct min_state *s = w->s;
+    size_t            i, j, k, ns = 0;
+    unsigned int      ncls, *id;
+    /* Rules sorted by starting state, and all the states used */
+    for(i = 0, j = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next, j++){
+                r[j] = (struct rule){l->st, d->st, l->ch, d->ch, d->mv};
+                s[ns++].st = l->st;
+                s[ns++].st = d->st;
+            }
+    s[ns++].st = 0;
+    qsort(r, nr, sizeof(*r), min_rule_cmp);
+    qsort(s, ns, sizeof(*s), min_st_cmp);
+    for(i = j = 0; i < ns; i++)
+        if(!j || s[j - 1].st != s[i].st)
+            s[j++].st = s[i].st;
+    ns = j;
+    /* First partition: not accepting, accepting, accepting start state */
+    for(i = 0; i < ns; i++){
+        s[i].acc   = set_get(tm->accept, s[i].st);
+        s[i].cls   = s[i].acc ? 1 + !s[i].st : 0;
+        s[i].e     = e;
+        s[i].len   = 0;
+        s[i].npred = 0;
+    }
+    for(i = 0; i < nr; i++){
+        j = min_state_find(s, ns, r[i].st_from);
+        if(s[j].cls == 1)
+            continue;
+        if(!s[j].len)
+            s[j].e = e + i;
+        k = min_state_find(s, ns, r[i].st_dest);
+        s[j].e[s[j].len++] = (struct min_edge){
+            r[i].ch_from, r[i].ch_dest, r[i].mv_dest, k, 0};
+        s[k].npred++;
+    }
+    /* Predecessors of each state, once for each transition */
+    for(i = 0, k = 0; i < ns; k += s[i].npred, s[i++].npred = 0)
+        s[i].pred = w->pred + k;
+    for(i = 0; i < ns; i++)
+        for(j = 0; j < s[i].len; j++){
+            k = s[i].e[j].dest;
+            s[k].pred[s[k].npred++] = s + i;
+        }
+    ncls = min_split(w, ns);
+    /* Number classes in order of their smallest state */
+    if(!(id = malloc(ncls * sizeof(*id))))
+        return -1;
+    for(i = 0; i < ncls; i++)
+        id[i] = ncls;
+    for(i = 0, k = 0; i < ns; i++){
+        if(id[s[i].cls] == ncls)
+            id[s[i].cls] = k++;
+        min_sign(s, s + i);
+    }
+    tm->stats.states     += ns;
+    tm->stats.rules      += nr;
+    tm->stats.min_states += k;
+    /*
+     * Rebuild rules from the smallest state of each class,
+     * rules and transitions are all copied in r and e
+     */
+    rule_dict_reset(tm->rules);
+    set_reset(tm->accept);
+    for(i = 0, k = 0; i < ns; i++){
+        if(id[s[i].cls] != k)
+            continue;
+        k++;
+        for(j = 0; j < s[i].len; j = min_edge_next(s + i, j)){
+            struct rule t = {id[s[i].cls], id[s[i].e[j].cls],
+                             s[i].e[j].ch_from, s[i].e[j].ch_dest,
+                             s[i].e[j].mv};
+            tm->stats.min_rules++;
+            if(rule_dict_insert(tm->rules, &t)){
+                free(id);
+                return -1;
+            }
+        }
+        if(s[i].acc && !set_put(tm->accept, id[s[i].cls])){
+            free(id);
+            return -1;
+        }
+    }
+    free(id);
+    return 0;
+}
+
+/******************** Refinement ********************/
+
+/*
+ * Classes are refined as in Hopcroft's algorithm: when the class of a
+ * state changes, only its predecessors may have different transitions
+ * from the other states of their class. These are touched and sorted by
+ * transitions, while the states not touched all have the same ones, so
+ * one of them stands for all. Each group of equal transitions is then
+ * a class, the largest one keeping the class id, so a state changes
+ * class O(log n) times.
+ */
+unsigned int min_split(struct min_work *w, size_t ns){
+    struct min_state  *s = w->s, **p = w->p, **t, *rep;
+    struct min_class  *c = w->c;
+    size_t             i, j, k, f, g, e, bf, bl, nb, nw = 0, nd;
+    unsigned int       y, n = 3;
+    /* Start from the first partition, with all the states changed */
+    for(y = 0; y < n; y++)
+        c[y] = (struct min_class){0, 0, 0};
+    for(i = 0; i < ns; i++)
+        c[s[i].cls].end++;
+    for(y = 0, k = 0; y < n; y++){
+        c[y].first = k;
+        c[y].end   = k += c[y].end;
+    }
+    for(i = 0; i < ns; i++){
+        s[i].pos    = c[s[i].cls].first + c[s[i].cls].ntouch++;
+        s[i].touch  = 0;
+        s[i].queue  = 1;
+        p[s[i].pos] = w->w[nw++] = s + i;
+    }
+    for(y = 0; y < n; y++)
+        c[y].ntouch = 0;
+    while(nw){
+        t = w->b;
+        w->b = w->w;
+        w->w = t;
+        nb = nw;
+        nw = 0;
+        /* Touch the predecessors of the states whose class changed */
+        for(i = nd = 0; i < nb; i++){
+            w->b[i]->queue = 0;
+            for(j = 0; j < w->b[i]->npred; j++)
+                if(!w->b[i]->pred[j]->touch)
+                    min_touch(w, w->b[i]->pred[j], &nd);
+        }
+        /* Sort transitions before any class changes */
+        for(i = 0; i < nd; i++){
+            y = w->dirty[i];
+            for(j = c[y].end - c[y].ntouch; j < c[y].end; j++)
+                min_sign(s, p[j]);
+            if(c[y].ntouch < c[y].end - c[y].first)
+                min_sign(s, p[c[y].first]);
+        }
+        for(i = 0; i < nd; i++){
+            y = w->dirty[i];
+            f = c[y].first;
+            e = c[y].end;
+            g = e - c[y].ntouch;
+            c[y].ntouch = 0;
+            qsort(p + g, e - g, sizeof(*p), min_sig_cmp);
+            for(j = g; j < e; j++){
+                p[j]->pos   = j;
+                p[j]->touch = 0;
+            }
+            /* Touched states like the others join them */
+            if(f < g){
+                rep = p[f];
+                for(j = g; j < e && min_sig_cmp(&rep, p + j); j++);
+                for(k = j; k < e && !min_sig_cmp(&rep, p + k); k++);
+                min_rotate(p, g, j, k);
+                g += k - j;
+            }
+            /* Find the largest group */
+            for(j = bf = bl = f; j < e; j = k)
+                if((k = min_group(p, j, g, e)) - j > bl - bf){
+                    bf = j;
+                    bl = k;
+                }
+            if(bf == f && bl == e)
+                continue;
+            /* Other groups are new classes */
+            for(j = f; j < e; j = k){
+                k = min_group(p, j, g, e);
+                if(j == bf)
+                    continue;
+                c[n] = (struct min_class){j, k, 0};
+                for(; j < k; j++){
+                    p[j]->cls = n;
+                    if(!p[j]->queue){
+                        p[j]->queue = 1;
+                        w->w[nw++]  = p[j];
+                    }
+                }
+                n++;
+            }
+            c[y].first = bf;
+            c[y].end   = bl;
+        }
+    }
+    return n;
+}
+
+void min_touch(struct min_work *w, struct min_state *x, size_t *nd){
+    struct min_class *c = w->c + x->cls;
+    struct min_state *t;
+    if(!c->ntouch++)
+        w->dirty[(*nd)++] = x->cls;
+    t = w->p[c->end - c->ntouch];
+    w->p[x->pos] = t;
+    t->pos       = x->pos;
+    x->pos       = c->end - c->ntouch;
+    w->p[x->pos] = x;
+    x->touch     = 1;
+}
+
+void min_sign(struct min_state *s, struct min_state *x){
+    size_t i;
+    for(i = 0; i < x->len; i++)
+        x->e[i].cls = s[x->e[i].dest].cls;
+    qsort(x->e, x->len, sizeof(*x->e), min_edge_cmp);
+}
+
+size_t min_group(struct min_state **p, size_t i, size_t g, size_t e){
+    size_t j;
+    if(i < g)
+        return g;
+    for(j = i + 1; j < e && !min_sig_cmp(p + i, p + j); j++);
+    return j;
+}
+
+void min_rotate(struct min_state **p, size_t i, size_t j, size_t k){
+    size_t t;
+    min_reverse(p, i, j);
+    min_reverse(p, j, k);
+    min_reverse(p, i, k);
+    for(t = i; t < k; t++)
+        p[t]->pos = t;
+}
+
+void min_reverse(struct min_state **p, size_t i, size_t j){
+    struct min_state *t;
+    for(; i + 1 < j; i++, j--){
+        t        = p[i];
+        p[i]     = p[j - 1];
+        p[j - 1] = t;
+    }
+}
+
+/******************** Comparison ********************/
+
+size_t min_state_find(struct min_state *s, size_t n, state st){
+    size_t lo = 0, hi = n, m;
+    while(lo < hi){
+        m = lo + (hi - lo) / 2;
+        if(s[m].st < st) lo = m + 1;
+        else             hi = m;
+    }
+    return lo;
+}
+
+int min_st_cmp(const void *a, const void *b){
+    state x = ((const struct min_state*)a)->st,
+          y = ((const struct min_state*)b)->st;
+    return (x > y) - (x < y);
+}
+
+/* Compare class, then transitions to different classes */
+int min_sig_cmp(const void *a, const void *b){
+    const struct min_state *x = *(struct min_state* const*)a,
+                           *y = *(struct min_state* const*)b;
+    size_t i, j;
+    int    c;
+    if(x->cls != y->cls)
+        return (x->cls > y->cls) - (x->cls < y->cls);
+    for(i = j = 0; i < x->len && j < y->len;
+        i = min_edge_next((struct min_state*)x, i),
+        j = min_edge_next((struct min_state*)y, j))
+        if((c = min_edge_cmp(x->e + i, y->e + j)))
+            return c;
+    return (i < x->len) - (j < y->len);
+}
+
+size_t min_edge_next(struct min_state *s, size_t i){
+    size_t j = i + 1;
+    while(j < s->len && !min_edge_cmp(s->e + i, s->e + j))
+        j++;
+    return j;
+}
+
+int min_edge_cmp(const void *a, const void *b){
+    const struct min_edge *x = a, *y = b;
+    if(x->ch_from != y->ch_from) return x->ch_from - y->ch_from;
+    if(x->ch_dest != y->ch_dest) return x->ch_dest - y->ch_dest;
+    if(x->mv      != y->mv     ) return x->mv      - y->mv;
+    return (x->cls > y->cls) - (x->cls < y->cls);
+}
+
+int min_rule_cmp(const void *a, const void *b){
+    state x = ((const struct rule*)a)->st_from,
+          y = ((const struct rule*)b)->st_from;
+    return (x > y) - (x < y);
+}
+/*
+ * ndtm.c:    Non-deterministic Turing machine simulator
+ *
+ * Author:    Giorgio Pristia
+ *
+ * This program takes in input rules, accepting states and max moves
+ * for a turing machine, then a list of strings to test the tm for.
+ * It prints to stdout 1 for every string accepted by the tm,
+ *                     0 for not accepted strings,
+ *                     U if the tm does not terminate in an accepting state.
+ * When a branch goes over max moves, it's considered not to terminate.
+ *
+ * Options:   -s bfs|dfs|iddfs|best  search strategy, default bfs
+ *            -b                     run deterministic machines in
+ *                                   lockstep batches of strings
+ *            -m                     a tr line in the run section starts
+ *                                   a new machine, instead of being run
+ *            -v                     print statistics to stderr
+ *            -p                     print latency percentiles and
+ *                                   hardware counters of the runs
+ *                                   of each machine to stderr
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define BUFSZ 0x800
+#define BLANK '_'
+#define LEFT  'L'
+#define STAY  'S'
+#define RIGHT 'R'
+#define OUT   "01U"
+
+/* Option flags */
+#define OPT_STATS 1
+#define OPT_MULTI 2
+
+const char * const strategy_n[] = {"bfs", "dfs", "iddfs", "best"};
+
+/* Functions to parse each section of the input */
+typedef void parse_funct(char*, struct machine*);
+parse_funct f_tr, f_acc, f_max, f_run,
+    * const parse[] = {f_tr, f_acc, f_max, f_run};
+
+/* Return option flags or -1 on invalid options */
+int  f_opts(int argc, char **argv, struct machine*);
+void f_stats(struct machine*);
+/* Print results of the strings queued for lockstep runs */
+void f_flush(struct machine*);
+
+/*
+ * The program takes input divided in 4 sections: tr, acc, max, run.
+ * Each section starts with a specific line and is parsed differently
+ * depending on the currente parser state,
+ * which is updated when a new section is encountered.
+ * With -m, a tr line in the run section starts a new machine: the
+ * engine is reset and its memory reused, so many machines can be run
+ * by the same process. Without it, tr is a string to run, as it could
+ * be in a single machine input.
+ */
+int main(int argc, char **argv){
+    char    buf[BUFSZ],      /* Temporary  buffer */
+           *lbuf    =  NULL, /* Increasing buffer */
+           *st_n[]  = {"tr\n", "acc\n", "max\n", "run\n", ""};
+    size_t  buf_sz,
+            lbuf_sz =  0,
+            lbuf_cap = 0;
+    int     st      = -1;    /* Current section state */
+    struct machine tm;
+    int t = tm_init(&tm);
+    assert(!t);
+    int opts = f_opts(argc, argv, &tm);
+    if(opts < 0){
+        fprintf(stderr, "usage: %s [-s bfs|dfs|iddfs|best] [-b] [-m] [-v] "
+                        "[-p]\n", *argv);
+        tm_destroy(&tm);
+        return EXIT_FAILURE;
+    }
+    while(!feof(stdin)){
+        /*
+         * Read characters from input to buf and increase lbuf
+         * False if the last iteration filled buf with the last
+         * input character, so now stdin is EOF and no new
+         * character has to be read
+         */
+        if(fgets(buf, sizeof(buf), stdin)){
+            /* Match the next section and continue */
+            if(!lbuf_sz && (!strcmp(st_n[st + 1], buf) ||
+                            (opts & OPT_MULTI && st == 3 &&
+                             !strcmp(*st_n, buf)))){
+                /* New machine after the run section */
+                if(st == 3){
+                    if(lockstep_ready(&tm))
+                        f_flush(&tm);
+                    if(tm.prof)
+                        profile_print(tm.prof, stderr);
+                    tm_reset(&tm);
+                    st = -1;
+                }
+                /* The machine is complete when run section starts */
+                if(++st == 3){
+                    t = tm_load(&tm);
+                    assert(!t);
+                }
+                continue;
+            }
+            if(st < 0) continue;
+            buf_sz = strlen(buf);
+            if(lbuf_sz + buf_sz + 1 > lbuf_cap){
+                lbuf_cap = 2 * (lbuf_sz + buf_sz + 1);
+                lbuf = realloc(lbuf, lbuf_cap);
+                assert(lbuf);
+            }
+            strcpy(lbuf + lbuf_sz, buf);
+            lbuf_sz += buf_sz;
+        }
+        /*
+         * Buffer is empty if buf was filled with the last characters
+         * and input ends in \n, so it has already been parsed
+         * Otherwise it is parsed if either the end of line or
+         * the end of file is reached
+         */
+        if(lbuf_sz && (lbuf[lbuf_sz - 1] == '\n' || feof(stdin))){
+            parse[st](lbuf, &tm);
+            lbuf_sz = 0;
+        }
+    }
+    free(lbuf);
+    if(lockstep_ready(&tm))
+        f_flush(&tm);
+    if(tm.prof)
+        profile_print(tm.prof, stderr);
+    if(opts & OPT_STATS)
+        f_stats(&tm);
+    tm_destroy(&tm);
+    return EXIT_SUCCESS;
+}
+
+/******************** Options ********************/
+
+int f_opts(int argc, char **argv, struct machine *tm){
+    int i, opts = 0;
+    size_t j;
+    for(i = 1; i < argc; i++){
+        if(!strcmp(argv[i], "-v"))
+            opts |= OPT_STATS;
+        else if(!strcmp(argv[i], "-b"))
+            tm->lockstep = 1;
+        else if(!strcmp(argv[i], "-m"))
+            opts |= OPT_MULTI;
+        else if(!strcmp(argv[i], "-p")){
+            if(!tm->prof && !(tm->prof = new_profile()))
+                return -1;
+        }
+        else if(!strcmp(argv[i], "-s") && ++i < argc){
+            for(j = 0; j < sizeof(strategy_n) / sizeof(*strategy_n); j++)
+                if(!strcmp(argv[i], strategy_n[j]))
+                    break;
+            if(j == sizeof(strategy_n) / sizeof(*strategy_n))
+                return -1;
+            tm->strategy = j;
+        }
+        else
+            return -1;
+    }
+    return opts;
+}
+
+void f_stats(struct machine *tm){
+    fprintf(stderr, "states:   %lu -> %lu\n"
+                    "rules:    %lu -> %lu\n",
+            tm->stats.states, tm->stats.min_states,
+            tm->stats.rules,  tm->stats.min_rules);
+    fprintf(stderr, "strategy: %s\n"
+                    "runs:     %lu\n"
+                    "expanded: %lu\n"
+                    "branched: %lu\n"
+                    "shared:   %lu\n"
+                    "peak:     %lu\n"
+                    "macro:    %lu\n"
+                    "runaway:  %lu\n"
+                    "lockstep: %lu\n",
+            strategy_n[tm->strategy], tm->stats.runs, tm->stats.expanded,
+            tm->stats.branched, tm->stats.shared, tm->stats.peak,
+            tm->stats.macro,
+            tm->stats.runaway, tm->stats.lockstep);
+}
+
+/******************** Parser functions ********************/
+
+void f_tr(char *s, struct machine *tm){
+    struct rule rule;
+    symbol ch_f, ch_d;
+    char mv;
+    if(sscanf(s, "%u %c %c %c %u", &rule.st_from, &ch_f, &ch_d, &mv,
+                                   &rule.st_dest) != 5)
+        return;                /* Not a rule                           */
+    rule.ch_from = ch_f == BLANK ? '\0' : ch_f; /* Blanks are replaced */
+    rule.ch_dest = ch_d == BLANK ? '\0' : ch_d; /* with zeroes,        */
+    switch(mv){                /* Moves with their corresponding value */
+        case LEFT:
+            rule.mv_dest = -1;
+            break;
+        case RIGHT:
+            rule.mv_dest =  1;
+            break;
+        case STAY:
+            rule.mv_dest =  0;
+    }
+    int t = rule_dict_insert(tm->rules, &rule);
+    assert(!t);
+}
+
+void f_acc(char *s, struct machine *tm){
+    int t = set_put(tm->accept, strtoul(s, NULL, 10));
+    assert(t);
+}
+
+void f_max(char *s, struct machine *tm){
+    tm->max = atoi(s);
+}
+
+void f_run(char *s, struct machine *tm){
+    tape *t = tape_init(s, BLANK, "\n");
+    assert(t);
+    struct tmconf *conf = new_tmconf(1);
+    assert(conf);
+    conf->ttl   = tm->max;
+    conf->t     = t;
+    conf->n     = 1;
+    conf->st[0] = 0;
+    if(lockstep_ready(tm)){
+        if(lockstep_put(tm, conf))
+            f_flush(tm);
+        return;
+    }
+    int v = tm_run(tm, conf);
+    assert(v >= 0);
+    printf("%c\n", v[OUT]);
+}
+
+void f_flush(struct machine *tm){
+    size_t i, n;
+    int *v = lockstep_run(tm, &n);
+    for(i = 0; i < n; i++){
+        assert(v[i] >= 0);
+        printf("%c\n", v[i][OUT]);
+    }
+}
+/*
+ * profile.c: Run latency and hardware counters
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Each run is timed into a log-linear histogram, as in HDR histograms:
+ * latencies below 2^PROF_SUB_BITS ns have a bucket each, then every
+ * power of two is split in 2^PROF_SUB_BITS buckets, so percentiles are
+ * within 1/2^PROF_SUB_BITS of the true value at any magnitude.
+ * On Linux the events are opened in a group with perf_event_open, user
+ * space only, and enabled just around the run. Events that can not be
+ * opened, as when perf events are not permitted, are left out.
+ * Runs are timed with the monotonic clock where POSIX provides it, else
+ * with the wall clock of C11, which may be stepped while timing.
+ */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NSEC 1000000000ULL
+
+const char * const prof_event_n[] =
+    {"cycles", "instructions", "cache misses", "branch misses"};
+
+/* Open the events in a group, leaving out those not available */
+void               profile_open  (struct profile*);
+/* Bucket of latency v, and the highest latency in bucket i */
+size_t             prof_bucket   (unsigned long long v);
+unsigned long long prof_bucket_max(size_t i);
+/* Latency below which a fraction q of the runs fall */
+unsigned long long prof_pct      (struct profile*, double q);
+/* Time in nanoseconds */
+unsigned long long prof_now      ();
+
+struct profile *new_profile(){
+    struct profile *p = calloc(1, sizeof(*p));
+    if(p)
+        profile_open(p);
+    return p;
+}
+
+#ifdef __linux__
+void profile_open(struct profile *p){
+    const unsigned long long config[] =
+        {PERF_COUNT_HW_CPU_CYCLES,   PERF_COUNT_HW_INSTRUCTIONS,
+         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    struct perf_event_attr a;
+    int i;
+    p->leader = -1;
+    for(i = 0; i < PROF_EVENTS; i++){
+        memset(&a, 0, sizeof(a));
+        a.type           = PERF_TYPE_HARDWARE;
+        a.size           = sizeof(a);
+        a.config         = config[i];
+        a.read_format    = PERF_FORMAT_GROUP;
+        a.disabled       = p->leader < 0;
+        a.exclude_kernel = 1;
+        a.exclude_hv     = 1;
+        p->fd[i] = syscall(SYS_perf_event_open, &a, 0, -1, p->leader, 0);
+        if(p->fd[i] >= 0 && p->leader < 0)
+            p->leader = p->fd[i];
+    }
+}
+#else
+void profile_open(struct profile *p){
+    int i;
+    for(i = 0; i < PROF_EVENTS; i++)
+        p->fd[i] = -1;
+    p->leader = -1;
+}
+#endif
+
+void profile_start(struct profile *p){
+#ifdef __linux__
+    if(p->leader >= 0){
+        ioctl(p->leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+        ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    p->t0 = prof_now();
+}
+
+void profile_stop(struct profile *p, size_t batch){
+    unsigned long long v = prof_now() - p->t0;
+#ifdef __linux__
+    /* Number of events, then their values in the order they were opened */
+    unsigned long long r[1 + PROF_EVENTS];
+    int i, j;
+    if(p->leader >= 0){
+        ioctl(p->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if(read(p->leader, r, sizeof(r)) > 0)
+            for(i = 0, j = 1; i < PROF_EVENTS; i++)
+                if(p->fd[i] >= 0 && (unsigned long long)j <= *r)
+                    p->count[i] += r[j++];
+    }
+#endif
+    if((long long)v < 0) /* The wall clock stepped back */
+        v = 0;
+    p->hist[prof_bucket(v)]++;
+    p->n++;
+    p->strings += batch;
+    p->sum += v;
+    if(v > p->max)
+        p->max = v;
+}
+
+void profile_print(struct profile *p, FILE *f){
+    const char *unit = p->strings ? "batch" : "run";
+    int i;
+    p->machine++;
+    if(!p->n)
+        return;
+    if(p->strings)
+        fprintf(f, "profile:  machine %u, %lu lockstep batches of %lu "
+                   "strings\n", p->machine, p->n, p->strings);
+    else
+        fprintf(f, "profile:  machine %u, %lu runs\n", p->machine, p->n);
+    fprintf(f, "latency:  mean %llu p50 %llu p99 %llu p999 %llu max %llu ns "
+               "per %s\n", p->sum / p->n, prof_pct(p, .5), prof_pct(p, .99),
+            prof_pct(p, .999), p->max, unit);
+    if(p->leader < 0)
+        fprintf(f, "counters: unavailable\n");
+    else for(i = 0; i < PROF_EVENTS; i++){
+        if(p->fd[i] < 0)
+            fprintf(f, "%-14s n/a\n", prof_event_n[i]);
+        else
+            fprintf(f, "%-14s %llu (%llu per %s)\n", prof_event_n[i],
+                    p->count[i], p->count[i] / p->n, unit);
+    }
+    if(p->fd[prof_cycles] >= 0 && p->fd[prof_instructions] >= 0 &&
+       p->count[prof_cycles])
+        fprintf(f, "%-14s %.2f\n", "ipc", (double)p->count[prof_instructions]
+                                          / p->count[prof_cycles]);
+    memset(p->hist,  0, sizeof(p->hist));
+    memset(p->count, 0, sizeof(p->count));
+    p->n = p->strings = 0;
+    p->sum = p->max = 0;
+}
+
+void delete_profile(struct profile *p){
+    int i;
+    if(!p)
+        return;
+#ifdef __linux__
+    for(i = PROF_EVENTS; i--;)
+        if(p->fd[i] >= 0)
+            close(p->fd[i]);
+#else
+    (void)i;
+#endif
+    free(p);
+}
+
+size_t prof_bucket(unsigned long long v){
+    int e, s;
+    if(v < 1U << PROF_SUB_BITS)
+        return v;
+    for(e = 0, s = 32; s; s >>= 1) /* Index of the highest bit set */
+        if(v >> (e + s))
+            e += s;
+    return ((size_t)(e - PROF_SUB_BITS + 1) << PROF_SUB_BITS) +
+           ((v >> (e - PROF_SUB_BITS)) & ((1U << PROF_SUB_BITS) - 1));
+}
+
+unsigned long long prof_bucket_max(size_t i){
+    int e;
+    if(i < 1U << PROF_SUB_BITS)
+        return i;
+    e = (i >> PROF_SUB_BITS) - 1;
+    return (((unsigned long long)(i & ((1U << PROF_SUB_BITS) - 1)) +
+             (1U << PROF_SUB_BITS) + 1) << e) - 1;
+}
+
+unsigned long long prof_pct(struct profile *p, double q){
+    unsigned long c = 0, k = q * p->n;
+    size_t i;
+    if(k < q * p->n || !k) /* Rank of the run, rounded up */
+        k++;
+    for(i = 0; i < PROF_BUCKETS; i++)
+        if((c += p->hist[i]) >= k)
+            break;
+    return i < PROF_BUCKETS && prof_bucket_max(i) < p->max ?
+           prof_bucket_max(i) : p->max;
+}
+
+unsigned long long prof_now(){
+    struct timespec t;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &t);
+#else
+    timespec_get(&t, TIME_UTC);
+#endif
+    return t.tv_sec * NSEC + t.tv_nsec;
+}
+/*
+ * queue.c:   Configuration queue
+ *
+ * Author:    Giorgio Pristia
+ *
+ * This queue is used to store configurations in BFS
+ * (dequeue) tail => => => head (enqueue)
+ * and, pushing on the tail instead, as a stack in DFS
+ * (dequeue) tail <= (push)
+ */
+
+#include <stdlib.h>
+
+struct tmconf *new_tmconf(size_t n){
+    struct tmconf *conf = malloc(sizeof(*conf) + n * sizeof(state));
+    if(conf){
+        conf->ttl  = 0;
+        conf->t    = NULL;
+        conf->next = NULL;
+        conf->n    = 0;
+        conf->size = n;
+    }
+    return conf;
+}
+
+struct tmconf *tmconf_resize(struct tmconf *conf, size_t n){
+    struct tmconf *c;
+    if(n <= conf->size)
+        return conf;
+    if(!(c = realloc(conf, sizeof(*c) + n * sizeof(state))))
+        return NULL;
+    c->size = n;
+    return c;
+}
+
+void delete_tmconf(struct tmconf *conf){
+        delete_tape(conf->t);
+        free(conf);
+}
+
+queue *new_queue(){
+    return calloc(1, sizeof(queue));
+}
+
+void delete_queue(queue *q){
+    struct tmconf *conf;
+    while((conf = dequeue(q)))
+        delete_tmconf(conf);
+    free(q);
+}
+/*
+ * rules.c:   Rules dictionary functions
+ *
+ * Author:    Giorgio Pristia
+ *
+ * The dictionary stores each rule in a hash table.
+ * Keys consist of the current state and read symbol,
+ * values are lists of destinations.
+ * When a rule is added, if a rule from that configuration
+ * already exists, the new non deterministic destination is pushed
+ * in the correct list of the dictionary. Otherwise a new element
+ * is inserted in the dictionary with a single destination in its list.
+ * Hash table grows twice larger when the dictionary is 3/4 full.
+ * When the dictionary is reset, its table is cleared and the nodes are
+ * kept in pools, so that a new machine is loaded without allocations.
+ *
+ * (state, symbol) => [(state, move, symbol) -> (state, move, symbol) -> ]
+ */
+
+#include <stdlib.h>
+
+#define DICT_MINSZ 8
+
+rule_list *rule_list_find  (rule_list*, state, symbol);
+void       rule_list_push(rule_list **list, rule_list *new);
+
+/* Return:  0 on success
+ *         -1 if malloc fails on new rule
+ *         -2 if rule_dest_push call fails on existing rule
+ */
+int        rule_list_insert(rule_dict*, rule_list**, hash, struct rule*);
+void       delete_rule_list(rule_list*);
+
+/* Return 0 on success, else -1 */
+int        rule_dest_push  (rule_dest **pool, rule_dest**, state, int, symbol);
+void       delete_rule_dest(rule_dest*);
+
+/******************** Dictionary ********************/
+
+rule_dict *new_rule_dict(){
+    rule_dict *dict = malloc(sizeof(*dict));
+    if(!dict)
+        return NULL;
+    dict->rule  = calloc(DICT_MINSZ, sizeof(*dict->rule));
+    if(!dict->rule){
+        free(dict);
+        return NULL;
+    }
+    dict->size  = DICT_MINSZ;
+    dict->count = 0;
+    dict->pool_list = NULL;
+    dict->pool_dest = NULL;
+    return dict;
+}
+
+int rule_dict_grow(rule_dict *dict){
+    rule_list **new_ht = calloc(dict->size * 2, sizeof(*new_ht));
+    if(!new_ht)
+        return -1;
+    size_t i;
+    rule_list *j, *k;
+    for(i = 0; i < dict->size; i++)
+        for(j = dict->rule[i]; j; j = k){
+            k = j->next;
+            rule_list_push(new_ht + j->hash % (dict->size * 2), j);
+        }
+    free(dict->rule);
+    dict->rule = new_ht;
+    dict->size *= 2;
+    return 0;
+}
+
+int rule_dict_insert(rule_dict *dict, struct rule *rule){
+    hash h = hash_f(rule->st_from, rule->ch_from);
+    /*
+     * Increase dictionary count only when a new rule is inserted
+     * and not when a new destination is added to an existing rule
+     */
+    int t = rule_list_insert(dict, dict->rule + h % dict->size, h, rule);
+    if(t < 0)
+        return -1;
+    dict->count += t;
+    if(dict->count > dict->size * 3 / 4)
+        rule_dict_grow(dict);
+    return 0;
+}
+
+void rule_dict_reset(rule_dict *dict){
+    size_t i;
+    rule_list *j, *k;
+    rule_dest *d;
+    for(i = 0; i < dict->size; i++){
+        for(j = dict->rule[i]; j; j = k){
+            k = j->next;
+            while((d = j->dest)){
+                j->dest = d->next;
+                d->next = dict->pool_dest;
+                dict->pool_dest = d;
+            }
+            rule_list_push(&dict->pool_list, j);
+        }
+        dict->rule[i] = NULL;
+    }
+    dict->count = 0;
+}
+
+void delete_rule_dict(rule_dict *dict){
+    size_t i;
+    for(i = 0; i < dict->size; i++)
+        delete_rule_list(dict->rule[i]);
+    delete_rule_list(dict->pool_list);
+    delete_rule_dest(dict->pool_dest);
+    free(dict->rule);
+    free(dict);
+}
+
+/******************** List ********************/
+
+void rule_list_push(rule_list **list, rule_list *new){
+        new->next = *list;
+        *list     = new;
+}
+
+int rule_list_insert(rule_dict *dict, rule_list **list, hash h,
+                     struct rule *rule){
+    int        incr = 0;
+    rule_list *new  = rule_list_find(*list, rule->st_from, rule->ch_from);
+    if(!new){
+        if((new = dict->pool_list))
+            dict->pool_list = new->next;
+        else if(!(new = malloc(sizeof(*new))))
+            return -1;
+        new->hash = h;
+        new->st   = rule->st_from;
+        new->ch   = rule->ch_from;
+        new->dest = NULL;
+        new->macro = NULL;
+        new->runaway = 0;
+        rule_list_push(list, new);
+        incr      = 1;
+    }
+    if(rule_dest_push(&dict->pool_dest, &new->dest, rule->st_dest,
+                      rule->mv_dest, rule->ch_dest) < 0)
+        return -2;
+    return incr;
+}
+
+void delete_rule_list(rule_list *list){
+    rule_list *t;
+    while(list){
+        t = list->next;
+        delete_rule_dest(list->dest);
+        free(list);
+        list = t;
+    }
+}
+
+/******************** Destination ********************/
+
+int rule_dest_push(rule_dest **pool, rule_dest **dest,
+                   state st, int mv, symbol ch){
+    rule_dest *new;
+    if((new = *pool))
+        *pool = new->next;
+    else if(!(new = malloc(sizeof(*new))))
+        return -1;
+    new->next = *dest;
+    new->st   = st;
+    new->mv   = mv;
+    new->ch   = ch;
+    new->acc  = 0;
+    *dest     = new;
+    return 0;
+}
+
+void delete_rule_dest(rule_dest *dest){
+     rule_dest *t;
+     while(dest){
+        t = dest->next;
+        free(dest);
+        dest = t;
+    }
+}
+/*
+ * tape.c:    Machine tape data structures
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Tapes are stored in groups, each group is a double linked list of arrays
+ * The nth element of the array is the cell of the nth tape of the group in
+ * the pointed position. New tapes are added to the group until it is full,
+ * then a new group is created. When a group is empty, it is destroyed.
+ * All tapes from a group link to the same metadata relative to
+ * used and available indices in the group
+ *
+ * t3:  _ .... a .... _
+ * t2:  b .... _ .... _
+ * t1:  a .... a .... _
+ * t0:  a .... b .... _
+ *      ^      ^      ^
+ *  <- c0 <-> c1 <-> c2 ->
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define WORD_BYTES sizeof(uint64_t)
+#define WORD_ONES  UINT64_C(0x0101010101010101)
+
+size_t span_up  (symbol*, size_t n, symbol ch, char *set);
+size_t span_down(symbol*, size_t n, symbol ch, char *set);
+
+tape *tape_branch(tape *t){
+    tape *tnew = calloc(1, sizeof(*tnew));
+    if(t && tnew) for(int i = 0; i <= 1; i++){
+        if(!(tnew->tail[i] = malloc(t->size[i] * sizeof(**tnew->tail)))){
+            free(*tnew->tail);
+            free(tnew);
+            return NULL;
+        }
+        memcpy(tnew->tail[i], t->tail[i], t->size[i]);
+        tnew->size[i] = t->size[i];
+        tnew->head = t->head;
+    }
+    return tnew;
+}
+
+tape *tape_init(symbol *s, symbol blank, symbol *term){
+    tape *t  = tape_branch(NULL);
+    if(!t) return NULL; 
+    t->size[1] = strcspn(s, term);
+    if(!t->size[1])   /* Empty string, the head is on a blank */
+        t->size[1] = 1;
+    t->tail[1] = calloc(t->size[1], sizeof(**t->tail));
+    for(size_t l = 0; s[l] && s[l] != *term; l++)
+        if(s[l] != blank)
+            t->tail[1][l] = s[l];
+    return t;
+}
+
+size_t tape_span(tape *t, int mv, symbol ch, char *set, size_t max){
+    size_t n = 0, i, len, m;
+    long   p = t->head;
+    symbol *a;
+    int    up;
+    while(n < max){
+        if(p >= 0){
+            a  = t->tail[1];
+            i  = p;
+            len = t->size[1];
+            up = mv > 0;
+        }
+        else{ /* Left tail is reversed */
+            a  = t->tail[0];
+            i  = ~p;
+            len = t->size[0];
+            up = mv < 0;
+        }
+        if(i >= len) /* Beyond the tape there are only blanks */
+            return (set ? set[0] : !ch) ? max : n;
+        /* Cells left in this tail, in the direction of the head */
+        len = up ? len - i : i + 1;
+        if(len > max - n)
+            len = max - n;
+        m  = up ? span_up  (a + i, len, ch, set)
+                : span_down(a + i, len, ch, set);
+        n += m;
+        p += (long)m * mv;
+        if(m < len)
+            break;
+    }
+    return n;
+}
+
+tape *tape_skip(tape *t, size_t n, int mv){
+    long h = t->head + (long)n * mv;
+    symbol *a;
+    if(h >= (signed)t->size[1]){
+        if(!(a = realloc(t->tail[1], (h + 1) * sizeof(*a))))
+            return NULL;
+        memset(a + t->size[1], 0, h + 1 - t->size[1]);
+        t->tail[1] = a;
+        t->size[1] = h + 1;
+    }
+    else if(h < -(signed)t->size[0]){
+        if(!(a = realloc(t->tail[0], -h * sizeof(*a))))
+            return NULL;
+        memset(a + t->size[0], 0, -h - t->size[0]);
+        t->tail[0] = a;
+        t->size[0] = -h;
+    }
+    t->head = h;
+    return t;
+}
+
+/*
+ * Spans over a single symbol compare a word at a time,
+ * as memchr does, then finish byte by byte, spans over
+ * a set look each symbol up in its table
+ */
+size_t span_up(symbol *a, size_t n, symbol ch, char *set){
+    size_t   i = 0;
+    uint64_t w, pat = (unsigned char)ch * WORD_ONES;
+    if(set){
+        while(i < n && set[(unsigned char)a[i]])
+            i++;
+        return i;
+    }
+    for(; i + WORD_BYTES <= n; i += WORD_BYTES){
+        memcpy(&w, a + i, WORD_BYTES);
+        if(w != pat)
+            break;
+    }
+    while(i < n && a[i] == ch)
+        i++;
+    return i;
+}
+
+/* Same as span_up but from a[0] down to a[1 - n] */
+size_t span_down(symbol *a, size_t n, symbol ch, char *set){
+    size_t   i = 0;
+    uint64_t w, pat = (unsigned char)ch * WORD_ONES;
+    if(set){
+        while(i < n && set[(unsigned char)*(a - i)])
+            i++;
+        return i;
+    }
+    for(; i + WORD_BYTES <= n; i += WORD_BYTES){
+        memcpy(&w, a - i - (WORD_BYTES - 1), WORD_BYTES);
+        if(w != pat)
+            break;
+    }
+    while(i < n && *(a - i) == ch)
+        i++;
+    return i;
+}
+
+void delete_tape(tape *t){
+    for(int i = 0; i <= 1; i++)
+        free(t->tail[i]);
+    free(t);
+}
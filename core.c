@@ -2,72 +2,526 @@
  * core.c:    Turing machine core
  *
  * Author:    Giorgio Pristia
+ *
+ * BFS, DFS and best-first search share the same loop and differ only in
+ * the frontier storing the configurations still to be expanded.
+ * A configuration of the frontier is a tape with a set of states: the
+ * destinations of all its states are grouped by symbol written and move,
+ * and the tape is copied only once per group, so branches that write
+ * and move the same way are kept on one tape instead of one each.
+ * Rules with two destinations writing and moving the same way are flagged
+ * when the machine is loaded: a single state with no such rule has
+ * nothing to group, so its tape is copied once per destination.
+ * Iterative deepening runs a depth-first search on a single tape,
+ * undoing each transition when backtracking, with a depth limit that
+ * doubles after each iteration until it reaches max moves, so memory is
+ * linear in max. It starts from the first state of the configuration.
+ * As a branch is non terminating only if it goes over max moves, every
+ * strategy gives the same result.
+ * When the machine is loaded its states are minimized, see minimize.c.
+ * Before each step, the macro steps found when the machine is loaded
+ * are taken at once, and branches running away on blanks past the end
+ * of the tape are non terminating without being stepped, see macro.c.
  */
 
 #include <stdlib.h>
 #include "core.h"
+#include "heap.h"
+#include "heuristic.h"
+#include "macro.h"
+#include "minimize.h"
+#include "lockstep.h"
+#include "profile.h"
+
+#define IDDFS_MINDEPTH 16
+#define TM_STEP_MIN    16
+#define TM_STEP_ISORT  16 /* Insertion sort up to this many steps */
+
+/* Destination of one of the states of a configuration being expanded */
+struct tm_step{
+    symbol      ch;
+    signed char mv;
+    state       st;
+};
+
+/* Frontier functions for each search strategy */
+typedef void          *front_new_funct(void);
+typedef int            front_put_funct(struct machine*, void*, struct tmconf*);
+typedef struct tmconf *front_get_funct(void*);
+typedef void           front_del_funct(void*);
+front_put_funct front_enqueue, front_push, front_heap_push;
+front_get_funct front_dequeue;
+front_new_funct * const f_front_new[] =
+    {(front_new_funct*)new_queue, (front_new_funct*)new_queue,
+     NULL,                        (front_new_funct*)new_heap};
+front_put_funct * const f_front_put[] =
+    {front_enqueue, front_push, NULL, front_heap_push};
+front_get_funct * const f_front_get[] =
+    {front_dequeue, front_dequeue, NULL, (front_get_funct*)heap_pop};
+front_del_funct * const f_front_del[] =
+    {(front_del_funct*)delete_queue, (front_del_funct*)delete_queue,
+     NULL,                           (front_del_funct*)delete_heap};
+
+int tm_search(struct machine*, struct tmconf*);
+int tm_iddfs (struct machine*, struct tmconf*);
+
+/*
+ * Take macro steps from configuration c while possible, r is the rule
+ * from c and is updated to the rule from the configuration reached
+ * Return  0: on success
+ *         2: non terminating
+ *        -1: memory error
+ */
+int tm_macro (struct machine*, struct tmconf *c, rule_list **r);
+
+/*
+ * Mark the destinations reaching an accepting state
+ * and the rules whose destinations can share a tape
+ */
+void tm_mark (struct machine*);
+
+/*
+ * Expand configuration c of a single state, whose rule r has no
+ * destinations to group, adding to n the configurations put in q
+ * Return  0: on success
+ *         1: accept
+ *         2: non terminating
+ *        -1: memory error
+ */
+int tm_branch(struct machine*, void *q, struct tmconf *c, rule_list *r,
+              unsigned long *n);
+
+/* Sort steps by symbol written, move and state */
+void tm_step_sort(struct tm_step*, size_t n);
+int  tm_step_cmp (const void*, const void*);
+
+/* Double the room for steps, return 0 on success, else -1 */
+int  tm_step_grow(struct machine*);
+
+/******************** Machine ********************/
+
+int tm_run(struct machine *tm, struct tmconf *c){
+    int o;
+    tm->stats.runs++;
+    if(tm->prof)
+        profile_start(tm->prof);
+    if(tm->strategy == search_iddfs)
+        o = tm_iddfs(tm, c);
+    else
+        o = tm_search(tm, c);
+    if(tm->prof)
+        profile_stop(tm->prof, 0);
+    return o;
+}
+
+int tm_init(struct machine *tm){
+    tm->rules = new_rule_dict();
+    if(!tm->rules)
+        return -1;
+    tm->accept = new_set();
+    if(!tm->accept){
+        free(tm->rules);
+        return -1;
+    }
+    tm->max      = 0;
+    tm->strategy = search_bfs;
+    tm->h        = &h_accept_dist;
+    tm->macros   = NULL;
+    tm->lockstep = 0;
+    tm->lanes    = NULL;
+    tm->step     = NULL;
+    tm->nstep    = 0;
+    tm->prof     = NULL;
+    tm->stats    = (struct tm_stats){0};
+    return 0;
+}
 
-int tm_run(struct tm *tm, struct tmconf *c){
+int tm_load(struct machine *tm){
+    if(tm_minimize(tm))
+        return -1;
+    tm_mark(tm);
+    if(macro_load(tm) || (tm->lockstep && lockstep_load(tm)))
+        return -1;
+    if(tm->strategy == search_best && tm->h->load)
+        return tm->h->load(tm);
+    return 0;
+}
+
+void tm_reset(struct machine *tm){
+    rule_dict_reset(tm->rules);
+    set_reset(tm->accept);
+    tm->max = 0;
+}
+
+void tm_mark(struct machine *tm){
+    rule_list *l;
+    rule_dest *d, *e;
+    size_t     i;
+    for(i = 0; i < tm->rules->size; i++)
+        for(l = tm->rules->rule[i]; l; l = l->next){
+            l->share = 0;
+            for(d = l->dest; d; d = d->next){
+                d->acc = set_get(tm->accept, d->st);
+                for(e = d->next; e && !l->share; e = e->next)
+                    l->share = e->ch == d->ch && e->mv == d->mv;
+            }
+        }
+}
+
+void tm_destroy(struct machine *tm){
+    delete_rule_dict(tm->rules);
+    delete_set(tm->accept);
+    delete_macro(tm->macros);
+    delete_lanes(tm->lanes);
+    free(tm->step);
+    delete_profile(tm->prof);
+}
+
+/******************** Frontier search ********************/
+
+int tm_search(struct machine *tm, struct tmconf *c){
+    rule_list *r;
     rule_dest *d;
-    struct tmconf *c_;
-    int o = 0;
-    struct queue *q = new_queue();
-    if(!q){
+    struct tmconf  *c_;
+    struct tm_step *s;
+    symbol ch;
+    size_t i, j, k, u;
+    unsigned int ttl;
+    int o = 0, m, live;
+    unsigned long n = 1; /* Configurations in the frontier */
+    front_put_funct *put = f_front_put[tm->strategy];
+    front_get_funct *get = f_front_get[tm->strategy];
+    void *q = f_front_new[tm->strategy]();
+    if(!q || put(tm, q, c)){
+        if(q) f_front_del[tm->strategy](q);
         delete_tmconf(c);
         return -1;
     }
-    enqueue(q, c);
-    /* Loop until reache accept state or queue is empty */
-    while(!(o & 1) && (c = dequeue(q))){
-        /* Outgoing transitions from the current configuration */
-        d = rule_dict_find(tm->rules, c->st, tape_read(c->t));
-        if(!d)                 /* No outgoing transitions: dead branch    */
-            delete_tmconf(c);
-        else if(!c->ttl){      /* There are outgoing transitions but time */
-            delete_tmconf(c);  /* to live is zero: non terminating branch */
-            o = 2;
+    /* Loop until reache accept state or frontier is empty */
+    while(!(o & 1) && (c = get(q))){
+        if(n-- > tm->stats.peak)
+            tm->stats.peak = n + 1;
+        /* Macro steps only for a single state, as they move the tape */
+        r = c->n == 1 ?
+            rule_dict_lookup(tm->rules, c->st[0], tape_read(c->t)) : NULL;
+        if(r && r->macro && c->ttl && (m = tm_macro(tm, c, &r))){
+            delete_tmconf(c);  /* Non terminating branch or memory error */
+            o = m;
+            continue;
         }
-        else for(; d; d = d->next){
-            if(set_get(tm->accept, d->st)){
-                delete_tmconf(c); /* As soon as an accepting state is */
-                o = 1;            /* reached, TM stops and returns 1  */
-                break;
+        /* Nothing to group: branch once per destination */
+        if(c->n == 1 && !(r && r->share)){
+            if((m = tm_branch(tm, q, c, r, &n)))
+                o = m;
+            continue;
+        }
+        /* Outgoing transitions from each state of the configuration */
+        ch = tape_read(c->t);
+        for(i = k = 0, live = 0; i < c->n && !(o & 1); i++){
+            if(c->n > 1)
+                r = rule_dict_lookup(tm->rules, c->st[i], ch);
+            if(!r || !r->dest) /* No outgoing transitions: dead state     */
+                continue;
+            if(r->runaway && tape_edge(c->t, r->runaway)){
+                tm->stats.runaway++;
+                o = 2;         /* Running away on blanks forever          */
+                continue;
             }
-            if(d->next){
-                if(!(c_ = calloc(1, sizeof(*c_)))){
+            live = 1;
+            if(!c->ttl)
+                continue;
+            for(d = r->dest; d; d = d->next){
+                if(d->acc){    /* As soon as an accepting state is */
+                    o = 1;     /* reached, TM stops and returns 1  */
+                    break;
+                }
+                if(k == tm->nstep && tm_step_grow(tm)){
+                    o = -1;
+                    break;
+                }
+                tm->step[k++] = (struct tm_step){d->ch, d->mv, d->st};
+            }
+        }
+        if(live && !c->ttl)    /* There are outgoing transitions but time */
+            o = 2;             /* to live is zero: non terminating branch */
+        if(o & 1 || !k){
+            delete_tmconf(c);
+            continue;
+        }
+        tm->stats.expanded++;
+        tm_step_sort(tm->step, k);
+        ttl = c->ttl - 1;
+        for(i = 0, s = tm->step; i < k; i = j){
+            /* States reached writing and moving the same way share a tape */
+            for(j = i + 1, u = 1; j < k && s[j].ch == s[i].ch &&
+                                  s[j].mv == s[i].mv; j++)
+                u += s[j].st != s[j - 1].st;
+            if(j < k){
+                if(!(c_ = new_tmconf(u)) || !(c_->t = tape_branch(c->t))){
+                    free(c_);
                     delete_tmconf(c);
                     o = -1;
                     break;
                 }
-                c_->t = tape_branch(c->t); /* Branch current configuration */
+                tm->stats.branched++;  /* Branch current configuration */
+            }
+            /* Last group is applied inplace without branching */
+            else if(!(c_ = tmconf_resize(c, u))){
+                delete_tmconf(c);
+                o = -1;
+                break;
+            }
+            /* Apply transition and put the configuration reached */
+            for(c_->n = 0; i < j; i++)
+                if(!c_->n || c_->st[c_->n - 1] != s[i].st)
+                    c_->st[c_->n++] = s[i].st;
+            tm->stats.shared += u - 1;
+            c_->ttl = ttl;
+            tape_write(c_->t, s[j - 1].ch, s[j - 1].mv);
+            if(put(tm, q, c_)){
+                delete_tmconf(c_);
+                if(j < k)
+                    delete_tmconf(c);
+                o = -1;
+                break;
             }
-            else /* Last transition is applied inplace without branching   */
-                c_ = c;
-            /* Apply transition and enqueue the configuration reached */
-            c_->st = d->st;
-            c_->ttl = c->ttl - 1;
-            tape_write(c_->t, d->ch, d->mv);
-            enqueue(q, c_);
-        };
+            n++;
+        }
     }
-    /* Clear all remaining enqueued configurations and return */
-    delete_queue(q);
+    /* Clear all remaining configurations and return */
+    f_front_del[tm->strategy](q);
     return o;
 }
 
-int tm_init(struct tm *tm){
-    tm->rules = new_rule_dict();
-    if(!tm->rules)
-        return -1;
-    tm->accept = new_set();
-    if(!tm->accept){
-        free(tm->rules);
+int tm_branch(struct machine *tm, void *q, struct tmconf *c, rule_list *r,
+              unsigned long *n){
+    rule_dest     *d = r ? r->dest : NULL;
+    struct tmconf *c_;
+    if(!d){                /* No outgoing transitions: dead branch    */
+        delete_tmconf(c);
+        return 0;
+    }
+    if(r->runaway && tape_edge(c->t, r->runaway)){
+        delete_tmconf(c);  /* Running away on blanks forever          */
+        tm->stats.runaway++;
+        return 2;
+    }
+    if(!c->ttl){           /* There are outgoing transitions but time */
+        delete_tmconf(c);  /* to live is zero: non terminating branch */
+        return 2;
+    }
+    for(tm->stats.expanded++; d; d = d->next){
+        if(d->acc){
+            delete_tmconf(c); /* As soon as an accepting state is */
+            return 1;         /* reached, TM stops and returns 1  */
+        }
+        if(d->next){
+            if(!(c_ = new_tmconf(1)) || !(c_->t = tape_branch(c->t))){
+                free(c_);
+                delete_tmconf(c);
+                return -1;
+            }
+            c_->n = 1;
+            tm->stats.branched++;  /* Branch current configuration */
+        }
+        else /* Last transition is applied inplace without branching   */
+            c_ = c;
+        /* Apply transition and put the configuration reached */
+        c_->st[0] = d->st;
+        c_->ttl   = c->ttl - 1;
+        tape_write(c_->t, d->ch, d->mv);
+        if(f_front_put[tm->strategy](tm, q, c_)){
+            delete_tmconf(c_);
+            if(c_ != c)
+                delete_tmconf(c);
+            return -1;
+        }
+        (*n)++;
+    }
+    return 0;
+}
+
+int tm_step_cmp(const void *a, const void *b){
+    const struct tm_step *x = a, *y = b;
+    if(x->ch != y->ch)
+        return (x->ch > y->ch) - (x->ch < y->ch);
+    if(x->mv != y->mv)
+        return (x->mv > y->mv) - (x->mv < y->mv);
+    return (x->st > y->st) - (x->st < y->st);
+}
+
+void tm_step_sort(struct tm_step *s, size_t n){
+    struct tm_step t;
+    size_t i, j;
+    if(n > TM_STEP_ISORT){
+        qsort(s, n, sizeof(*s), tm_step_cmp);
+        return;
+    }
+    for(i = 1; i < n; i++){
+        for(t = s[i], j = i; j && tm_step_cmp(&t, s + j - 1) < 0; j--)
+            s[j] = s[j - 1];
+        s[j] = t;
+    }
+}
+
+int tm_step_grow(struct machine *tm){
+    size_t n = tm->nstep ? tm->nstep * 2 : TM_STEP_MIN;
+    struct tm_step *t = realloc(tm->step, n * sizeof(*t));
+    if(!t)
         return -1;
+    tm->step  = t;
+    tm->nstep = n;
+    return 0;
+}
+
+int front_enqueue(struct machine *tm, void *q, struct tmconf *c){
+    (void)tm;
+    enqueue(q, c);
+    return 0;
+}
+
+int front_push(struct machine *tm, void *q, struct tmconf *c){
+    (void)tm;
+    push(q, c);
+    return 0;
+}
+
+int front_heap_push(struct machine *tm, void *h, struct tmconf *c){
+    return heap_push(h, tm->h->eval(tm, c), c);
+}
+
+struct tmconf *front_dequeue(void *q){
+    return dequeue(q);
+}
+
+int tm_macro(struct machine *tm, struct tmconf *c, rule_list **r){
+    unsigned long n;
+    for(; *r && (*r)->macro && c->ttl;
+        *r = rule_dict_lookup(tm->rules, c->st[0], tape_read(c->t))){
+        if((n = macro_len((*r)->macro, c->t, c->ttl)) > c->ttl)
+            return 2;
+        if(!macro_apply((*r)->macro, c->st, c->t, n))
+            return -1;
+        c->ttl -= n;
+        tm->stats.macro += n;
     }
     return 0;
 }
 
-void tm_destroy(struct tm *tm){
-    delete_rule_dict(tm->rules);
-    delete_set(tm->accept);
+/******************** Iterative deepening ********************/
+
+/* Transition applied at each depth, to be undone on backtrack */
+struct iddfs_frame{
+    rule_dest   *d;    /* NULL for a macro step                         */
+    state        st;   /* State, symbol and head before the transition  */
+    symbol       ch;
+    long         head;
+    unsigned int k;    /* Depth before the transition                   */
+};
+
+/* Return the frame at index i, growing the stack if needed, else NULL */
+struct iddfs_frame *iddfs_push(struct iddfs_frame **f, size_t *fsz,
+                               size_t i, unsigned int max){
+    struct iddfs_frame *t;
+    if(i == *fsz){
+        *fsz = *fsz ? *fsz * 2 : IDDFS_MINDEPTH;
+        if(*fsz > max)
+            *fsz = max;
+        if(!(t = realloc(*f, *fsz * sizeof(**f))))
+            return NULL;
+        *f = t;
+    }
+    return *f + i;
+}
+
+int tm_iddfs(struct machine *tm, struct tmconf *c){
+    struct iddfs_frame *f = NULL, *t = NULL;
+    rule_list    *r;
+    rule_dest    *d;
+    state         st;
+    tape         *tp  = c->t;
+    size_t        i, fsz = 0;
+    unsigned long n;
+    unsigned int  k, lim = c->ttl < IDDFS_MINDEPTH ? c->ttl : IDDFS_MINDEPTH;
+    int           o, cut;
+    for(;; lim = lim > c->ttl / 2 ? c->ttl : lim * 2){
+        o   = 0;
+        cut = 0;
+        st  = c->st[0];
+        k   = 0;
+        i   = 0;
+        for(;;){
+            /* Descend from configuration at depth k */
+            if((r = rule_dict_lookup(tm->rules, st, tape_read(tp)))){
+                if(k < lim && r->macro &&
+                   (n = macro_len(r->macro, tp, lim - k)) <= lim - k){
+                    if(!(t = iddfs_push(&f, &fsz, i++, c->ttl))){
+                        o = -1;
+                        break;
+                    }
+                    *t = (struct iddfs_frame){NULL, st, tape_read(tp),
+                                              tp->head, k};
+                    if(!macro_apply(r->macro, &st, tp, n)){
+                        o = -1;
+                        break;
+                    }
+                    k += n;
+                    tm->stats.macro += n;
+                    continue;
+                }
+                if(r->runaway && tape_edge(tp, r->runaway)){
+                    tm->stats.runaway++;
+                    o = 2;                /* Running away on blanks        */
+                }
+                else if(k == lim || r->macro){ /* Transitions beyond limit:*/
+                    if(lim == c->ttl)     /* non terminating if it is max  */
+                        o = 2;
+                    else                  /* else go deeper next iteration */
+                        cut = 1;
+                }
+                else{
+                    tm->stats.expanded++;
+                    for(d = r->dest; d; d = d->next)
+                        if(d->acc)
+                            break;
+                    if(d){            /* As soon as an accepting state is */
+                        o = 1;        /* reached, TM stops and returns 1  */
+                        break;
+                    }
+                    if(!(t = iddfs_push(&f, &fsz, i++, c->ttl))){
+                        o = -1;
+                        break;
+                    }
+                    *t = (struct iddfs_frame){r->dest, st, tape_read(tp),
+                                              tp->head, k++};
+                    if(k > tm->stats.peak)
+                        tm->stats.peak = k;
+                    st = t->d->st;
+                    tape_write(tp, t->d->ch, t->d->mv);
+                    continue;
+                }
+            }
+            /* Backtrack to the next untried transition */
+            for(; i; i--){
+                t = f + i - 1;
+                tp->head = t->head;
+                tape_write(tp, t->ch, 0);
+                st = t->st;
+                k  = t->k;
+                if(t->d && (t->d = t->d->next))
+                    break;
+            }
+            if(!i)
+                break;
+            st = t->d->st;
+            tape_write(tp, t->d->ch, t->d->mv);
+            k++;
+        }
+        /* Tree fully explored within the limit, or accepted */
+        if(o & 1 || !cut)
+            break;
+    }
+    free(f);
+    delete_tmconf(c);
+    return o;
 }
@@ -12,14 +12,66 @@
 #include "tape.h"
 #include "queue.h"
 
+struct machine;
+
+/* Order in which the configurations of a run are explored */
+enum strategy{
+    search_bfs,   /* Breadth-first, configurations in a queue             */
+    search_dfs,   /* Depth-first, configurations in a stack               */
+    search_iddfs, /* Iterative deepening depth-first on a single tape     */
+    search_best   /* Best-first, configurations in a heap by heuristic    */
+};
+
+/* Heuristic for best-first search, lower values are explored first */
+typedef unsigned int h_eval_funct(struct machine*, struct tmconf*);
+typedef int          h_load_funct(struct machine*);
+
+struct heuristic{
+    h_load_funct *load; /* Called once the machine is loaded, may be NULL */
+    h_eval_funct *eval;
+};
+
+/* Counters accumulated over all the machines and runs */
+struct tm_stats{
+    unsigned long states,     /* States and rules loaded                    */
+                  rules,
+                  min_states, /* States and rules after minimization        */
+                  min_rules,
+                  runs,       /* Strings run                                */
+                  expanded,   /* Configurations with outgoing transitions   */
+                  branched,   /* Tapes copied on non deterministic branches */
+                  shared,     /* Branches sharing the tape of another one   */
+                  peak,       /* Largest frontier, or deepest IDDFS stack   */
+                  macro,      /* Steps taken by macro steps                 */
+                  runaway,    /* Branches found running away on blanks      */
+                  lockstep;   /* Strings run in lockstep                    */
+};
+
 /* Machine settings */
-struct tm{
-    rule_dict    *rules;
-    set          *accept;
-    unsigned int  max;
+struct machine{
+    rule_dict              *rules;
+    set                    *accept;
+    unsigned int            max;
+    enum strategy           strategy;
+    const struct heuristic *h;
+    struct macro           *macros;
+    int                     lockstep; /* Run deterministic machines in    */
+    struct lanes           *lanes;    /* lockstep batches, see lockstep.c */
+    struct tm_step         *step;     /* Destinations of the states being */
+    size_t                  nstep;    /* expanded                         */
+    struct profile         *prof;     /* Runs timed if not NULL, see      */
+                                      /* profile.c                        */
+    struct tm_stats         stats;
 };
 
-int  tm_init   (struct tm*);
+int  tm_init   (struct machine*);
+
+/*
+ * Prepare the machine for running once rules, accept states and max
+ * moves have been read
+ * Return 0 on success, else -1
+ */
+int  tm_load   (struct machine*);
 
 /*
  * Takes a tm and a starting configuration: tape, state and time to live
@@ -28,8 +80,12 @@ int  tm_init   (struct tm*);
  *         1: accept
  *         2: non terminating
  *        -1: memory error
+ * The result does not depend on the strategy
  */
-int  tm_run    (struct tm*, struct tmconf*);
-void tm_destroy(struct tm*);
+int  tm_run    (struct machine*, struct tmconf*);
+
+/* Clear rules, accept states and max moves to load a new machine */
+void tm_reset  (struct machine*);
+void tm_destroy(struct machine*);
 
 #endif
@@ -0,0 +1,77 @@
+/*
+ * heap.c:    Configuration priority queue
+ *
+ * Author:    Giorgio Pristia
+ *
+ * This binary min-heap is used to store configurations in best-first
+ * search, the key of each configuration is given by the heuristic.
+ * Nodes are stored in an array that grows twice larger when full.
+ *
+ *          0
+ *        /   \
+ *       1     2        children of n are 2n + 1 and 2n + 2
+ *      / \   / \
+ *     3   4 5   6
+ */
+
+#include <stdlib.h>
+#include "heap.h"
+
+#define HEAP_MINSZ 16
+
+heap *new_heap(){
+    heap *h = malloc(sizeof(*h));
+    if(!h)
+        return NULL;
+    h->node = malloc(HEAP_MINSZ * sizeof(*h->node));
+    if(!h->node){
+        free(h);
+        return NULL;
+    }
+    h->size  = HEAP_MINSZ;
+    h->count = 0;
+    return h;
+}
+
+int heap_push(heap *h, unsigned int key, struct tmconf *conf){
+    size_t i, p;
+    if(h->count == h->size){
+        struct heap_node *t = realloc(h->node, h->size * 2 * sizeof(*t));
+        if(!t)
+            return -1;
+        h->node  = t;
+        h->size *= 2;
+    }
+    /* Sift up the new node from the last position */
+    for(i = h->count++; i && h->node[p = (i - 1) / 2].key > key; i = p)
+        h->node[i] = h->node[p];
+    h->node[i].key  = key;
+    h->node[i].conf = conf;
+    return 0;
+}
+
+struct tmconf *heap_pop(heap *h){
+    size_t i, c;
+    if(!h->count)
+        return NULL;
+    struct tmconf   *conf = h->node->conf;
+    struct heap_node last = h->node[--h->count];
+    /* Sift down the last node from the root */
+    for(i = 0; (c = 2 * i + 1) < h->count; i = c){
+        if(c + 1 < h->count && h->node[c + 1].key < h->node[c].key)
+            c++;
+        if(last.key <= h->node[c].key)
+            break;
+        h->node[i] = h->node[c];
+    }
+    h->node[i] = last;
+    return conf;
+}
+
+void delete_heap(heap *h){
+    struct tmconf *conf;
+    while((conf = heap_pop(h)))
+        delete_tmconf(conf);
+    free(h->node);
+    free(h);
+}
@@ -0,0 +1,34 @@
+/*
+ * heap.h:    Configuration priority queue
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdlib.h>
+#include "queue.h"
+
+struct heap_node{
+    unsigned int   key;
+    struct tmconf *conf;
+};
+
+struct heap{
+    struct heap_node *node;
+    size_t            size,
+                      count;
+};
+
+typedef struct heap heap;
+
+/* Return the heap or NULL if malloc fails */
+heap          *new_heap   ();
+/* Return 0 on success, else -1 */
+int            heap_push  (heap*, unsigned int key, struct tmconf*);
+/* Return the configuration with the lowest key, NULL if heap is empty */
+struct tmconf *heap_pop   (heap*);
+void           delete_heap(heap*);
+
+#endif
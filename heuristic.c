@@ -0,0 +1,116 @@
+/*
+ * heuristic.c: Best-first search heuristics
+ *
+ * Author:    Giorgio Pristia
+ *
+ * The accept distance of a rule is the least number of transitions
+ * needed to reach an accepting state after reading its symbol,
+ * the distance of a state is the least distance among its rules.
+ * Once the machine is loaded, rules are indexed by destination state and
+ * distances are found breadth first, starting from the rules that reach
+ * an accepting state: the first rule of a state to be dequeued gives the
+ * state its distance, and every rule leading there is one step further.
+ * Rules that can not reach an accepting state are left at H_INF.
+ * A configuration is as close as the closest of its states.
+ *
+ * (state, symbol) => 1 + min(dist(dest state))  or 1 if dest accepts
+ */
+
+#include <stdlib.h>
+#include "heuristic.h"
+
+#define H_INF ((unsigned int)-1)
+
+h_load_funct h_accept_load;
+h_eval_funct h_accept_eval;
+
+const struct heuristic h_accept_dist = {h_accept_load, h_accept_eval};
+
+/* Rule r has a destination to state st */
+struct h_pred{
+    state      st;
+    rule_list *r;
+};
+
+int h_pred_cmp(const void *a, const void *b){
+    state x = ((const struct h_pred*)a)->st,
+          y = ((const struct h_pred*)b)->st;
+    return (x > y) - (x < y);
+}
+
+/* Index of the first predecessor of st, or n if none */
+size_t h_pred_find(struct h_pred *p, size_t n, state st){
+    size_t lo = 0, hi = n, m;
+    while(lo < hi){
+        m = lo + (hi - lo) / 2;
+        if(p[m].st < st) lo = m + 1;
+        else             hi = m;
+    }
+    return lo < n && p[lo].st == st ? lo : n;
+}
+
+int h_accept_load(struct machine *tm){
+    rule_dict     *dict = tm->rules;
+    rule_list    **q, *l;
+    rule_dest     *d;
+    struct h_pred *p;
+    size_t         i, j, n = 0, head = 0, tail = 0;
+    char          *done;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next)
+                n++;
+    if(!(p = malloc((n + 1) * sizeof(*p))))
+        return -1;
+    /* Queue of rules by distance, each rule enters it once */
+    if(!(q = malloc((dict->count + 1) * sizeof(*q)))){
+        free(p);
+        return -1;
+    }
+    /* Whether the predecessors of a state have been visited,
+     * stored at the index of its first predecessor */
+    if(!(done = calloc(n + 1, sizeof(*done)))){
+        free(q);
+        free(p);
+        return -1;
+    }
+    for(n = i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            l->dist = H_INF;
+            for(d = l->dest; d; d = d->next){
+                p[n].st  = d->st;
+                p[n++].r = l;
+                if(d->acc && l->dist == H_INF){
+                    l->dist   = 1;
+                    q[tail++] = l;
+                }
+            }
+        }
+    qsort(p, n, sizeof(*p), h_pred_cmp);
+    while(head < tail){
+        l = q[head++];
+        if((j = h_pred_find(p, n, l->st)) == n || done[j])
+            continue;
+        done[j] = 1;
+        for(; j < n && p[j].st == l->st; j++)
+            if(p[j].r->dist == H_INF){
+                p[j].r->dist = l->dist + 1;
+                q[tail++]    = p[j].r;
+            }
+    }
+    free(done);
+    free(q);
+    free(p);
+    return 0;
+}
+
+unsigned int h_accept_eval(struct machine *tm, struct tmconf *c){
+    rule_list   *r;
+    unsigned int v = H_INF;
+    size_t       i;
+    symbol       ch = tape_read(c->t);
+    for(i = 0; i < c->n; i++)
+        if((r = rule_dict_lookup(tm->rules, c->st[i], ch)) && r->dist < v)
+            v = r->dist;
+    return v;
+}
@@ -0,0 +1,18 @@
+/*
+ * heuristic.h: Best-first search heuristics
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+#include "core.h"
+
+/*
+ * Least number of transitions from the current state and symbol
+ * to an accepting state, ignoring the rest of the tape
+ */
+extern const struct heuristic h_accept_dist;
+
+#endif
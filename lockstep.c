@@ -0,0 +1,161 @@
+/*
+ * lockstep.c: Lockstep runs of deterministic machines
+ *
+ * Author:    Giorgio Pristia
+ *
+ * When every rule of the machine has a single destination, rules are
+ * flattened in a table indexed by state and symbol column, states being
+ * dense once minimized. Queued strings are then run in lanes: each
+ * iteration steps every lane once, so the table lookups of different
+ * lanes do not depend on each other and can overlap.
+ * Lanes take the macro steps of their rules as tm_run does, so a sweep
+ * or a chain costs a lane a single iteration.
+ * A lane is retired as soon as its string accepts, rejects or runs out
+ * of moves, and takes the next queued string.
+ * As strings of a batch interleave, profiling times the whole batch.
+ *
+ *            st  col       st  col       st  col
+ * lane 0:  [ 3 | a ] ->  [ 4 | b ] ->  [ 4 | _ ] -> accept, next string
+ * lane 1:  [ 0 | b ] ->  [ 2 | b ] ->  [ 1 | a ] -> ...
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lockstep.h"
+#include "macro.h"
+#include "profile.h"
+
+#define LANE_MAXRULES (1 << 20) /* Largest table, else run one by one */
+
+int lockstep_load(struct machine *tm){
+    rule_dict        *dict = tm->rules;
+    rule_list        *l;
+    struct lanes     *t    = tm->lanes;
+    struct lane_rule *r;
+    size_t            i, nst = 1, nsym = 1;
+    /* Lanes of the previous machine are reused */
+    if(t)
+        t->nsym = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            if(l->dest->next)   /* Non deterministic */
+                return 0;
+            if(l->st >= nst)      nst = l->st + 1;
+            if(l->dest->st >= nst) nst = l->dest->st + 1;
+        }
+    if(!t && !(t = tm->lanes = calloc(1, sizeof(*t))))
+        return -1;
+    memset(t->sym, 0, sizeof(t->sym));
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            if(!t->sym[(unsigned char)l->ch])
+                t->sym[(unsigned char)l->ch] = nsym++;
+    if(nst > LANE_MAXRULES / nsym)
+        return 0;
+    if(nst * nsym > t->size){
+        if(!(r = realloc(t->rule, nst * nsym * sizeof(*r))))
+            return -1;
+        t->rule = r;
+        t->size = nst * nsym;
+    }
+    memset(t->rule, 0, nst * nsym * sizeof(*t->rule));
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            t->rule[l->st * nsym + t->sym[(unsigned char)l->ch]] =
+                (struct lane_rule){l->dest->st, l->dest->ch, l->dest->mv,
+                                   1 + l->dest->acc, l->runaway, l->macro};
+    t->nsym = nsym;
+    return 0;
+}
+
+int lockstep_put(struct machine *tm, struct tmconf *c){
+    tm->lanes->c[tm->lanes->n++] = c;
+    return tm->lanes->n == LANE_BATCH;
+}
+
+int *lockstep_run(struct machine *tm, size_t *n){
+    struct lanes     *t = tm->lanes;
+    struct lane_rule  r;
+    tape             *tp [LANES];
+    state             st [LANES];
+    unsigned int      ttl[LANES];
+    size_t            c  [LANES], i, live = 0, next = 0;
+    unsigned long     steps = 0, macro = 0, m;
+    if(!t->n){
+        *n = 0;
+        return t->out;
+    }
+    if(tm->prof)
+        profile_start(tm->prof);
+    for(; live < LANES && next < t->n; live++, next++){
+        c[live]   = next;
+        tp[live]  = t->c[next]->t;
+        st[live]  = t->c[next]->st[0];
+        ttl[live] = t->c[next]->ttl;
+    }
+    while(live){
+        for(i = 0; i < live;){
+            r = t->rule[st[i] * t->nsym +
+                        t->sym[(unsigned char)tape_read(tp[i])]];
+            if(r.flag == 1 && ttl[i] && r.macro){
+                if((m = macro_len(r.macro, tp[i], ttl[i])) <= ttl[i] &&
+                   macro_apply(r.macro, &st[i], tp[i], m)){
+                    ttl[i] -= m;
+                    macro  += m;
+                    i++;
+                    continue;
+                }
+                /* Non terminating macro or memory error */
+                t->out[c[i]] = m > ttl[i] ? 2 : -1;
+            }
+            else if(r.flag == 1 && ttl[i] &&
+                    !(r.run && tape_edge(tp[i], r.run))){
+                tape_write(tp[i], r.ch, r.mv);
+                st[i] = r.st;
+                ttl[i]--;
+                steps++;
+                i++;
+                continue;
+            }
+            else{
+                /* Retire the lane, same checks as tm_run */
+                t->out[c[i]] = !r.flag ? 0 : r.flag == 1 || !ttl[i] ? 2 : 1;
+                if(r.flag == 2 && ttl[i])
+                    steps++;
+            }
+            delete_tmconf(t->c[c[i]]);
+            if(next < t->n){
+                c[i]   = next;
+                tp[i]  = t->c[next]->t;
+                st[i]  = t->c[next]->st[0];
+                ttl[i] = t->c[next]->ttl;
+                next++;
+            }
+            else{
+                live--;
+                c[i]   = c[live];
+                tp[i]  = tp[live];
+                st[i]  = st[live];
+                ttl[i] = ttl[live];
+            }
+        }
+    }
+    if(tm->prof)
+        profile_stop(tm->prof, t->n);
+    tm->stats.runs     += t->n;
+    tm->stats.lockstep += t->n;
+    tm->stats.expanded += steps;
+    tm->stats.macro    += macro;
+    *n   = t->n;
+    t->n = 0;
+    return t->out;
+}
+
+void delete_lanes(struct lanes *t){
+    if(!t)
+        return;
+    while(t->n)
+        delete_tmconf(t->c[--t->n]);
+    free(t->rule);
+    free(t);
+}
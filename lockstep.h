@@ -0,0 +1,58 @@
+/*
+ * lockstep.h: Lockstep runs of deterministic machines
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <limits.h>
+#include "core.h"
+
+#define LANES      16          /* Strings run at the same time */
+#define LANE_BATCH (4 * LANES) /* Strings queued before a run  */
+
+/* Rule from a state and a symbol column */
+struct lane_rule{
+    state         st;
+    symbol        ch;
+    signed char   mv;
+    char          flag;  /* 0: no rule, 1: rule, 2: rule to accepting state */
+    signed char   run;   /* Runaway direction, see macro.c                 */
+    struct macro *macro; /* Macro step from this rule, see macro.c         */
+};
+
+struct lanes{
+    struct lane_rule *rule;                /* States times columns     */
+    size_t            size,
+                      nsym;                /* 0 if machine not flat    */
+    unsigned char     sym[1 << CHAR_BIT];  /* Column of each symbol,   */
+    struct tmconf    *c[LANE_BATCH];       /* 0 if no rule reads it    */
+    int               out[LANE_BATCH];
+    size_t            n;
+};
+
+/*
+ * Flatten the rules of a loaded machine if it is deterministic,
+ * reusing the lanes of the previous one
+ * Return 0 on success, else -1
+ */
+int  lockstep_load(struct machine*);
+
+/* True if the loaded machine runs in lockstep */
+static inline int lockstep_ready(struct machine *tm){
+    return tm->lanes && tm->lanes->nsym;
+}
+
+/* Queue a starting configuration, return 1 if the batch is full */
+int  lockstep_put (struct machine*, struct tmconf*);
+/*
+ * Run the queued configurations, results are the same as tm_run
+ * Return the results in queue order and set n to their number,
+ * a result is -1 if memory ran out while running its string
+ */
+int *lockstep_run (struct machine*, size_t *n);
+void delete_lanes (struct lanes*);
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * macro.c:   Macro steps
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Once the machine is loaded its rules are scanned for runs of
+ * steps that can be taken at once, without a trip through the main loop.
+ * Every step of a macro is deterministic and never reaches an accepting
+ * state, so it is equivalent to take all of them decreasing time to live
+ * by the number of steps.
+ *
+ * A sweep is made of the rules of a state that leave the symbol and the
+ * state unchanged and move the same way, e.g. 1 a a R 1 and 1 b b R 1:
+ * the head moves until a symbol not in the sweep is found, which can
+ * be counted scanning the tape, a word at a time for a single symbol or
+ * looking each cell up in a table of the swept symbols. A sweep over
+ * blanks never ends past the end of the tape.
+ *
+ * A chain is a sequence of deterministic S rules, each one reading the
+ * symbol written by the previous one: only the last state and symbol
+ * matter. If the chain comes back to one of its rules it never ends.
+ *
+ * A runaway is a cycle of deterministic rules reading blank and moving
+ * the same way, e.g. 5 _ a R 6 and 6 _ _ R 5: once the head is on the
+ * last cell of the tape in that direction it only reads blanks, so the
+ * branch never ends, whatever it writes behind.
+ *
+ * Chains and runaways are walked once: the rules met on the way are kept
+ * on a stack, then each one takes the result of the rest of the walk.
+ *
+ * (1, a) => sweep R {a, b}           (2, a) => chain 3 steps: (5, c)
+ * (5, _) => runaway R
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+
+#define SET_SIZE  (1 << CHAR_BIT)
+#define RUN_TODO  2 /* Runaway of the rule not found yet */
+#define RUN_WALK  3 /* Rule on the walk in progress      */
+
+/* Take a macro from the pool or allocate it, and add it to the machine */
+struct macro *macro_new(struct machine*, struct macro **pool);
+
+/*
+ * Give a macro to each rule starting a chain of at least two,
+ * stk has room for all the rules
+ * Return 0 on success, else -1
+ */
+int  macro_chains  (struct machine*, struct macro **pool, rule_list **stk);
+/* Set the direction of the runaway from each blank rule, 0 if none */
+void macro_runaways(rule_dict*, rule_list **stk);
+
+int macro_is_sweep(rule_list*);
+int macro_is_stay (rule_list*);
+int macro_sweep_cmp(const void*, const void*);
+
+int macro_load(struct machine *tm){
+    rule_dict    *dict = tm->rules;
+    rule_list   **r, *l;
+    struct macro *m = NULL, *pool = tm->macros;
+    size_t        i, n = 0;
+    /* Macros of the previous machine are reused */
+    tm->macros = NULL;
+    if(!(r = malloc((dict->count + 1) * sizeof(*r)))){
+        delete_macro(pool);
+        return -1;
+    }
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            l->macro = NULL;
+            if(macro_is_sweep(l))
+                r[n++] = l;
+        }
+    /* Sweeps, a macro for each state and direction */
+    qsort(r, n, sizeof(*r), macro_sweep_cmp);
+    for(i = 0; i < n; i++){
+        if(!i || macro_sweep_cmp(r + i - 1, r + i)){
+            if(!(m = macro_new(tm, &pool)) || (!m->set &&
+               !(m->set = malloc(SET_SIZE * sizeof(*m->set))))){
+                delete_macro(pool);
+                free(r);
+                return -1;
+            }
+            memset(m->set, 0, SET_SIZE * sizeof(*m->set));
+            m->type    = macro_sweep;
+            m->mv      = r[i]->dest->mv;
+            m->ch      = r[i]->ch;
+        }
+        m->len++;
+        m->set[(unsigned char)r[i]->ch] = 1;
+        r[i]->macro = m;
+    }
+    /* Chains, then runaways, using r as stack */
+    if(macro_chains(tm, &pool, r)){
+        delete_macro(pool);
+        free(r);
+        return -1;
+    }
+    macro_runaways(dict, r);
+    delete_macro(pool);
+    free(r);
+    return 0;
+}
+
+struct macro *macro_new(struct machine *tm, struct macro **pool){
+    struct macro *m;
+    if((m = *pool))
+        *pool = m->next;
+    else if(!(m = calloc(1, sizeof(*m))))
+        return NULL;
+    m->len     = 0;
+    m->next    = tm->macros;
+    tm->macros = m;
+    return m;
+}
+
+unsigned long macro_len(struct macro *m, tape *t, unsigned int max){
+    switch(m->type){
+        case macro_sweep:
+            return tape_span(t, m->mv, m->ch, m->len > 1 ? m->set : NULL,
+                             max + 1ul);
+        case macro_chain:
+            return m->len > max ? max + 1ul : m->len;
+        default:
+            return max + 1ul;
+    }
+}
+
+tape *macro_apply(struct macro *m, state *st, tape *t, unsigned long n){
+    if(m->type == macro_sweep)
+        return tape_skip(t, n, m->mv);
+    *st = m->st;
+    return tape_write(t, m->ch, 0);
+}
+
+void delete_macro(struct macro *m){
+    struct macro *t;
+    while(m){
+        t = m->next;
+        free(m->set);
+        free(m);
+        m = t;
+    }
+}
+
+/******************** Rule classification ********************/
+
+int macro_chains(struct machine *tm, struct macro **pool, rule_list **stk){
+    rule_dict    *dict = tm->rules;
+    rule_list    *l, *s;
+    struct macro *m;
+    size_t        i, n;
+    unsigned int  len = 0;
+    state         st  = 0;
+    symbol        ch  = 0;
+    int           loop;
+    /* Rules on the walk are marked by runaway, which is set afterwards */
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            l->runaway = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            /* Walk to the end, to a rule already done or back on the walk */
+            for(n = 0, s = l; s && macro_is_stay(s) && !s->macro &&
+                              !s->runaway;
+                s = rule_dict_lookup(dict, s->dest->st, s->dest->ch)){
+                s->runaway = 1;
+                stk[n++]   = s;
+            }
+            if(!n)
+                continue;
+            loop = 0;
+            len  = 0;
+            if(s && macro_is_stay(s)){
+                if(s->runaway || s->macro->type == macro_loop)
+                    loop = 1;
+                else{
+                    len = s->macro->len;
+                    st  = s->macro->st;
+                    ch  = s->macro->ch;
+                }
+            }
+            /* Each rule takes the rest of the chain plus itself */
+            while(n--){
+                s = stk[n];
+                s->runaway = 0;
+                if(!len && !loop){
+                    st = s->dest->st;
+                    ch = s->dest->ch;
+                }
+                if(++len < 2 && !loop)
+                    continue;
+                if(!(m = macro_new(tm, pool)))
+                    return -1;
+                m->type  = loop ? macro_loop : macro_chain;
+                m->st    = st;
+                m->ch    = ch;
+                m->len   = len;
+                s->macro = m;
+            }
+        }
+    return 0;
+}
+
+void macro_runaways(rule_dict *dict, rule_list **stk){
+    rule_list *l, *s;
+    rule_dest *d;
+    size_t     i, n;
+    int        mv, run;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            l->runaway = l->ch ? 0 : RUN_TODO;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next){
+            if(l->runaway != RUN_TODO)
+                continue;
+            /* Walk deterministic blank rules moving the same way */
+            mv = l->dest->mv;
+            for(n = 0, s = l; s && s->runaway == RUN_TODO;
+                s = rule_dict_lookup(dict, d->st, 0)){
+                d = s->dest;
+                if(d->next || d->acc || !mv || d->mv != mv)
+                    break;
+                s->runaway = RUN_WALK;
+                stk[n++]   = s;
+            }
+            /* A cycle, or a rule already known to run away the same way */
+            run = s && (s->runaway == RUN_WALK || s->runaway == mv) ? mv : 0;
+            if(!n)
+                l->runaway = 0;
+            while(n--)
+                stk[n]->runaway = run;
+        }
+}
+
+int macro_is_sweep(rule_list *r){
+    rule_dest *d = r->dest;
+    return !d->next && d->mv && d->st == r->st && d->ch == r->ch &&
+           !d->acc;
+}
+
+int macro_is_stay(rule_list *r){
+    rule_dest *d = r->dest;
+    return !d->next && !d->mv && !d->acc;
+}
+
+int macro_sweep_cmp(const void *a, const void *b){
+    rule_list *x = *(rule_list* const*)a,
+              *y = *(rule_list* const*)b;
+    if(x->st != y->st)
+        return (x->st > y->st) - (x->st < y->st);
+    return x->dest->mv - y->dest->mv;
+}
@@ -0,0 +1,42 @@
+/*
+ * macro.h:   Macro steps
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "core.h"
+
+struct macro{
+    enum {macro_sweep, /* Rules leaving symbol, state unchanged and move  */
+          macro_chain, /* Deterministic stationary rules                  */
+          macro_loop   /* Deterministic stationary rules that never end   */
+    }             type;
+    int           mv;    /* Sweep direction                               */
+    char         *set;   /* Swept symbols table, if more than ch          */
+    symbol        ch;    /* Swept symbol or symbol left by the chain      */
+    state         st;    /* State reached by the chain                    */
+    unsigned int  len;   /* Chain length or number of swept symbols       */
+    struct macro *next;
+};
+
+/*
+ * Find sweeps, chains and runaways in the rules of a loaded machine,
+ * reusing the macros of the previous one
+ * Return 0 on success, else -1
+ */
+int           macro_load  (struct machine*);
+
+/*
+ * Return the number of steps the macro takes from the current tape,
+ * or max + 1 if the macro takes more than max steps
+ */
+unsigned long macro_len   (struct macro*, tape*, unsigned int max);
+/* Apply the macro taking n steps, as returned by macro_len */
+tape         *macro_apply (struct macro*, state*, tape*, unsigned long n);
+
+void          delete_macro(struct macro*);
+
+#endif
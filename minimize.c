@@ -0,0 +1,427 @@
+/*
+ * minimize.c: Machine state minimization
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Two states are equivalent when, for every symbol read, they have the
+ * same transitions writing the same symbol, moving the same way and
+ * reaching equivalent states: a run from either of them gives the same
+ * result. States are first split in accepting and not accepting, then
+ * each class is split by the transitions of its states, with destinations
+ * replaced by their class, until no class is split anymore.
+ * Accepting states stop the machine as soon as they are reached, so their
+ * transitions are ignored, except for the start state which is never
+ * checked for acceptance. The rules are then rebuilt with a state for
+ * each class, numbered in order of their smallest state, so the start
+ * state is still 0.
+ *
+ * 0 a a R 1    0 b b R 2                  0 a a R 1    0 b b R 1
+ * 1 a a R 3    2 a a R 4    acc 3 4  =>   1 a a R 2    acc 2
+ */
+
+#include <stdlib.h>
+#include "minimize.h"
+
+/* Transition from a state, with destination as index and class */
+struct min_edge{
+    symbol        ch_from,
+                  ch_dest;
+    int           mv;
+    size_t        dest;
+    unsigned int  cls;
+};
+
+/*
+ * Transitions of a state are sorted by symbols, move and class,
+ * so that transitions to the same class are next to each other
+ * and count as one
+ */
+struct min_state{
+    state              st;
+    unsigned int       cls;
+    struct min_edge   *e;
+    size_t             len;
+    int                acc;
+    size_t             pos;   /* Index in the partition                   */
+    struct min_state **pred;  /* States with transitions to this one      */
+    size_t             npred;
+    char               touch, /* Class to be checked against its own      */
+                       queue; /* Class changed, predecessors to be touched */
+};
+
+/* A class is a range of the partition, touched states at its end */
+struct min_class{
+    size_t first,
+           end,
+           ntouch;
+};
+
+/* Arrays used by the minimization, sized by the number of rules */
+struct min_work{
+    struct rule       *r;
+    struct min_edge   *e;
+    struct min_state  *s;
+    struct min_state **p,     /* Partition, states grouped by class        */
+                     **w,     /* States whose class changed                */
+                     **b,     /* States whose predecessors are touched now */
+                     **pred;
+    struct min_class  *c;
+    unsigned int      *dirty; /* Classes with touched states               */
+};
+
+/* Return 0 on success, else -1 */
+int    min_refine    (struct machine*, struct min_work*, size_t nr);
+/* Split classes until their states have the same transitions, return ncls */
+unsigned int min_split(struct min_work*, size_t ns);
+/* Move a state to the touched states at the end of its class */
+void   min_touch     (struct min_work*, struct min_state*, size_t *nd);
+/* Sort the transitions of a state by class of their destination */
+void   min_sign      (struct min_state *s, struct min_state*);
+/* End of the group of states starting at i, states before g are one group */
+size_t min_group     (struct min_state**, size_t i, size_t g, size_t e);
+/* Move p[j, k) before p[i, j) */
+void   min_rotate    (struct min_state**, size_t i, size_t j, size_t k);
+void   min_reverse   (struct min_state**, size_t i, size_t j);
+size_t min_state_find(struct min_state*, size_t n, state);
+/* Index of the next transition to a different class after i */
+size_t min_edge_next (struct min_state*, size_t i);
+int    min_st_cmp    (const void*, const void*);
+int    min_sig_cmp   (const void*, const void*);
+int    min_edge_cmp  (const void*, const void*);
+int    min_rule_cmp  (const void*, const void*);
+
+int tm_minimize(struct machine *tm){
+    rule_dict         *dict = tm->rules;
+    rule_list         *l;
+    rule_dest         *d;
+    size_t             i, nr = 0;
+    for(i = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next)
+                nr++;
+    /*
+     * Each rule uses at most two states, plus the start state,
+     * and there can be two more classes left empty at first
+     */
+    struct min_work w = {
+        malloc((nr + 1)     * sizeof(*w.r)),
+        malloc((nr + 1)     * sizeof(*w.e)),
+        malloc((2 * nr + 1) * sizeof(*w.s)),
+        malloc((2 * nr + 1) * sizeof(*w.p)),
+        malloc((2 * nr + 1) * sizeof(*w.w)),
+        malloc((2 * nr + 1) * sizeof(*w.b)),
+        malloc((nr + 1)     * sizeof(*w.pred)),
+        malloc((2 * nr + 3) * sizeof(*w.c)),
+        malloc((2 * nr + 3) * sizeof(*w.dirty))
+    };
+    int o = w.r && w.e && w.s && w.p && w.w && w.b && w.pred && w.c &&
+            w.dirty ? min_refine(tm, &w, nr) : -1;
+    free(w.dirty);
+    free(w.c);
+    free(w.pred);
+    free(w.b);
+    free(w.w);
+    free(w.p);
+    free(w.s);
+    free(w.e);
+    free(w.r);
+    return o;
+}
+
+int min_refine(struct machine *tm, struct min_work *w, size_t nr){
+    rule_dict        *dict = tm->rules;
+    rule_list        *l;
+    rule_dest        *d;
+    struct rule      *r = w->r;
+    struct min_edge  *e = w->e;
+    struct min_state *s = w->s;
+    size_t            i, j, k, ns = 0;
+    unsigned int      ncls, *id;
+    /* Rules sorted by starting state, and all the states used */
+    for(i = 0, j = 0; i < dict->size; i++)
+        for(l = dict->rule[i]; l; l = l->next)
+            for(d = l->dest; d; d = d->next, j++){
+                r[j] = (struct rule){l->st, d->st, l->ch, d->ch, d->mv};
+                s[ns++].st = l->st;
+                s[ns++].st = d->st;
+            }
+    s[ns++].st = 0;
+    qsort(r, nr, sizeof(*r), min_rule_cmp);
+    qsort(s, ns, sizeof(*s), min_st_cmp);
+    for(i = j = 0; i < ns; i++)
+        if(!j || s[j - 1].st != s[i].st)
+            s[j++].st = s[i].st;
+    ns = j;
+    /* First partition: not accepting, accepting, accepting start state */
+    for(i = 0; i < ns; i++){
+        s[i].acc   = set_get(tm->accept, s[i].st);
+        s[i].cls   = s[i].acc ? 1 + !s[i].st : 0;
+        s[i].e     = e;
+        s[i].len   = 0;
+        s[i].npred = 0;
+    }
+    for(i = 0; i < nr; i++){
+        j = min_state_find(s, ns, r[i].st_from);
+        if(s[j].cls == 1)
+            continue;
+        if(!s[j].len)
+            s[j].e = e + i;
+        k = min_state_find(s, ns, r[i].st_dest);
+        s[j].e[s[j].len++] = (struct min_edge){
+            r[i].ch_from, r[i].ch_dest, r[i].mv_dest, k, 0};
+        s[k].npred++;
+    }
+    /* Predecessors of each state, once for each transition */
+    for(i = 0, k = 0; i < ns; k += s[i].npred, s[i++].npred = 0)
+        s[i].pred = w->pred + k;
+    for(i = 0; i < ns; i++)
+        for(j = 0; j < s[i].len; j++){
+            k = s[i].e[j].dest;
+            s[k].pred[s[k].npred++] = s + i;
+        }
+    ncls = min_split(w, ns);
+    /* Number classes in order of their smallest state */
+    if(!(id = malloc(ncls * sizeof(*id))))
+        return -1;
+    for(i = 0; i < ncls; i++)
+        id[i] = ncls;
+    for(i = 0, k = 0; i < ns; i++){
+        if(id[s[i].cls] == ncls)
+            id[s[i].cls] = k++;
+        min_sign(s, s + i);
+    }
+    tm->stats.states     += ns;
+    tm->stats.rules      += nr;
+    tm->stats.min_states += k;
+    /*
+     * Rebuild rules from the smallest state of each class,
+     * rules and transitions are all copied in r and e
+     */
+    rule_dict_reset(tm->rules);
+    set_reset(tm->accept);
+    for(i = 0, k = 0; i < ns; i++){
+        if(id[s[i].cls] != k)
+            continue;
+        k++;
+        for(j = 0; j < s[i].len; j = min_edge_next(s + i, j)){
+            struct rule t = {id[s[i].cls], id[s[i].e[j].cls],
+                             s[i].e[j].ch_from, s[i].e[j].ch_dest,
+                             s[i].e[j].mv};
+            tm->stats.min_rules++;
+            if(rule_dict_insert(tm->rules, &t)){
+                free(id);
+                return -1;
+            }
+        }
+        if(s[i].acc && !set_put(tm->accept, id[s[i].cls])){
+            free(id);
+            return -1;
+        }
+    }
+    free(id);
+    return 0;
+}
+
+/******************** Refinement ********************/
+
+/*
+ * Classes are refined as in Hopcroft's algorithm: when the class of a
+ * state changes, only its predecessors may have different transitions
+ * from the other states of their class. These are touched and sorted by
+ * transitions, while the states not touched all have the same ones, so
+ * one of them stands for all. Each group of equal transitions is then
+ * a class, the largest one keeping the class id, so a state changes
+ * class O(log n) times.
+ */
+unsigned int min_split(struct min_work *w, size_t ns){
+    struct min_state  *s = w->s, **p = w->p, **t, *rep;
+    struct min_class  *c = w->c;
+    size_t             i, j, k, f, g, e, bf, bl, nb, nw = 0, nd;
+    unsigned int       y, n = 3;
+    /* Start from the first partition, with all the states changed */
+    for(y = 0; y < n; y++)
+        c[y] = (struct min_class){0, 0, 0};
+    for(i = 0; i < ns; i++)
+        c[s[i].cls].end++;
+    for(y = 0, k = 0; y < n; y++){
+        c[y].first = k;
+        c[y].end   = k += c[y].end;
+    }
+    for(i = 0; i < ns; i++){
+        s[i].pos    = c[s[i].cls].first + c[s[i].cls].ntouch++;
+        s[i].touch  = 0;
+        s[i].queue  = 1;
+        p[s[i].pos] = w->w[nw++] = s + i;
+    }
+    for(y = 0; y < n; y++)
+        c[y].ntouch = 0;
+    while(nw){
+        t = w->b;
+        w->b = w->w;
+        w->w = t;
+        nb = nw;
+        nw = 0;
+        /* Touch the predecessors of the states whose class changed */
+        for(i = nd = 0; i < nb; i++){
+            w->b[i]->queue = 0;
+            for(j = 0; j < w->b[i]->npred; j++)
+                if(!w->b[i]->pred[j]->touch)
+                    min_touch(w, w->b[i]->pred[j], &nd);
+        }
+        /* Sort transitions before any class changes */
+        for(i = 0; i < nd; i++){
+            y = w->dirty[i];
+            for(j = c[y].end - c[y].ntouch; j < c[y].end; j++)
+                min_sign(s, p[j]);
+            if(c[y].ntouch < c[y].end - c[y].first)
+                min_sign(s, p[c[y].first]);
+        }
+        for(i = 0; i < nd; i++){
+            y = w->dirty[i];
+            f = c[y].first;
+            e = c[y].end;
+            g = e - c[y].ntouch;
+            c[y].ntouch = 0;
+            qsort(p + g, e - g, sizeof(*p), min_sig_cmp);
+            for(j = g; j < e; j++){
+                p[j]->pos   = j;
+                p[j]->touch = 0;
+            }
+            /* Touched states like the others join them */
+            if(f < g){
+                rep = p[f];
+                for(j = g; j < e && min_sig_cmp(&rep, p + j); j++);
+                for(k = j; k < e && !min_sig_cmp(&rep, p + k); k++);
+                min_rotate(p, g, j, k);
+                g += k - j;
+            }
+            /* Find the largest group */
+            for(j = bf = bl = f; j < e; j = k)
+                if((k = min_group(p, j, g, e)) - j > bl - bf){
+                    bf = j;
+                    bl = k;
+                }
+            if(bf == f && bl == e)
+                continue;
+            /* Other groups are new classes */
+            for(j = f; j < e; j = k){
+                k = min_group(p, j, g, e);
+                if(j == bf)
+                    continue;
+                c[n] = (struct min_class){j, k, 0};
+                for(; j < k; j++){
+                    p[j]->cls = n;
+                    if(!p[j]->queue){
+                        p[j]->queue = 1;
+                        w->w[nw++]  = p[j];
+                    }
+                }
+                n++;
+            }
+            c[y].first = bf;
+            c[y].end   = bl;
+        }
+    }
+    return n;
+}
+
+void min_touch(struct min_work *w, struct min_state *x, size_t *nd){
+    struct min_class *c = w->c + x->cls;
+    struct min_state *t;
+    if(!c->ntouch++)
+        w->dirty[(*nd)++] = x->cls;
+    t = w->p[c->end - c->ntouch];
+    w->p[x->pos] = t;
+    t->pos       = x->pos;
+    x->pos       = c->end - c->ntouch;
+    w->p[x->pos] = x;
+    x->touch     = 1;
+}
+
+void min_sign(struct min_state *s, struct min_state *x){
+    size_t i;
+    for(i = 0; i < x->len; i++)
+        x->e[i].cls = s[x->e[i].dest].cls;
+    qsort(x->e, x->len, sizeof(*x->e), min_edge_cmp);
+}
+
+size_t min_group(struct min_state **p, size_t i, size_t g, size_t e){
+    size_t j;
+    if(i < g)
+        return g;
+    for(j = i + 1; j < e && !min_sig_cmp(p + i, p + j); j++);
+    return j;
+}
+
+void min_rotate(struct min_state **p, size_t i, size_t j, size_t k){
+    size_t t;
+    min_reverse(p, i, j);
+    min_reverse(p, j, k);
+    min_reverse(p, i, k);
+    for(t = i; t < k; t++)
+        p[t]->pos = t;
+}
+
+void min_reverse(struct min_state **p, size_t i, size_t j){
+    struct min_state *t;
+    for(; i + 1 < j; i++, j--){
+        t        = p[i];
+        p[i]     = p[j - 1];
+        p[j - 1] = t;
+    }
+}
+
+/******************** Comparison ********************/
+
+size_t min_state_find(struct min_state *s, size_t n, state st){
+    size_t lo = 0, hi = n, m;
+    while(lo < hi){
+        m = lo + (hi - lo) / 2;
+        if(s[m].st < st) lo = m + 1;
+        else             hi = m;
+    }
+    return lo;
+}
+
+int min_st_cmp(const void *a, const void *b){
+    state x = ((const struct min_state*)a)->st,
+          y = ((const struct min_state*)b)->st;
+    return (x > y) - (x < y);
+}
+
+/* Compare class, then transitions to different classes */
+int min_sig_cmp(const void *a, const void *b){
+    const struct min_state *x = *(struct min_state* const*)a,
+                           *y = *(struct min_state* const*)b;
+    size_t i, j;
+    int    c;
+    if(x->cls != y->cls)
+        return (x->cls > y->cls) - (x->cls < y->cls);
+    for(i = j = 0; i < x->len && j < y->len;
+        i = min_edge_next((struct min_state*)x, i),
+        j = min_edge_next((struct min_state*)y, j))
+        if((c = min_edge_cmp(x->e + i, y->e + j)))
+            return c;
+    return (i < x->len) - (j < y->len);
+}
+
+size_t min_edge_next(struct min_state *s, size_t i){
+    size_t j = i + 1;
+    while(j < s->len && !min_edge_cmp(s->e + i, s->e + j))
+        j++;
+    return j;
+}
+
+int min_edge_cmp(const void *a, const void *b){
+    const struct min_edge *x = a, *y = b;
+    if(x->ch_from != y->ch_from) return x->ch_from - y->ch_from;
+    if(x->ch_dest != y->ch_dest) return x->ch_dest - y->ch_dest;
+    if(x->mv      != y->mv     ) return x->mv      - y->mv;
+    return (x->cls > y->cls) - (x->cls < y->cls);
+}
+
+int min_rule_cmp(const void *a, const void *b){
+    state x = ((const struct rule*)a)->st_from,
+          y = ((const struct rule*)b)->st_from;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,19 @@
+/*
+ * minimize.h: Machine state minimization
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef MINIMIZE_H
+#define MINIMIZE_H
+
+#include "core.h"
+
+/*
+ * Merge equivalent states of a loaded machine and renumber them densely,
+ * the start state is still 0
+ * Return 0 on success, else -1
+ */
+int tm_minimize(struct machine*);
+
+#endif
@@ -9,6 +9,16 @@
  *                     0 for not accepted strings,
  *                     U if the tm does not terminate in an accepting state.
  * When a branch goes over max moves, it's considered not to terminate.
+ *
+ * Options:   -s bfs|dfs|iddfs|best  search strategy, default bfs
+ *            -b                     run deterministic machines in
+ *                                   lockstep batches of strings
+ *            -m                     a tr line in the run section starts
+ *                                   a new machine, instead of being run
+ *            -v                     print statistics to stderr
+ *            -p                     print latency percentiles and
+ *                                   hardware counters of the runs
+ *                                   of each machine to stderr
  */
 
 #include <stdlib.h>
@@ -16,6 +26,8 @@
 #include <string.h>
 #include <assert.h>
 #include "core.h"
+#include "lockstep.h"
+#include "profile.h"
 
 #define BUFSZ 0x800
 #define BLANK '_'
@@ -24,27 +36,51 @@
 #define RIGHT 'R'
 #define OUT   "01U"
 
+/* Option flags */
+#define OPT_STATS 1
+#define OPT_MULTI 2
+
+const char * const strategy_n[] = {"bfs", "dfs", "iddfs", "best"};
+
 /* Functions to parse each section of the input */
-typedef void parse_funct(char*, struct tm*);
+typedef void parse_funct(char*, struct machine*);
 parse_funct f_tr, f_acc, f_max, f_run,
     * const parse[] = {f_tr, f_acc, f_max, f_run};
 
+/* Return option flags or -1 on invalid options */
+int  f_opts(int argc, char **argv, struct machine*);
+void f_stats(struct machine*);
+/* Print results of the strings queued for lockstep runs */
+void f_flush(struct machine*);
+
 /*
  * The program takes input divided in 4 sections: tr, acc, max, run.
  * Each section starts with a specific line and is parsed differently
  * depending on the currente parser state,
  * which is updated when a new section is encountered.
+ * With -m, a tr line in the run section starts a new machine: the
+ * engine is reset and its memory reused, so many machines can be run
+ * by the same process. Without it, tr is a string to run, as it could
+ * be in a single machine input.
  */
-int main(){
+int main(int argc, char **argv){
     char    buf[BUFSZ],      /* Temporary  buffer */
            *lbuf    =  NULL, /* Increasing buffer */
            *st_n[]  = {"tr\n", "acc\n", "max\n", "run\n", ""};
     size_t  buf_sz,
-            lbuf_sz =  0;
+            lbuf_sz =  0,
+            lbuf_cap = 0;
     int     st      = -1;    /* Current section state */
-    struct tm tm;
+    struct machine tm;
     int t = tm_init(&tm);
     assert(!t);
+    int opts = f_opts(argc, argv, &tm);
+    if(opts < 0){
+        fprintf(stderr, "usage: %s [-s bfs|dfs|iddfs|best] [-b] [-m] [-v] "
+                        "[-p]\n", *argv);
+        tm_destroy(&tm);
+        return EXIT_FAILURE;
+    }
     while(!feof(stdin)){
         /*
          * Read characters from input to buf and increase lbuf
@@ -54,14 +90,32 @@ int main(){
          */
         if(fgets(buf, sizeof(buf), stdin)){
             /* Match the next section and continue */
-            if(!strcmp(st_n[st + 1], buf)){
-                ++st;
+            if(!lbuf_sz && (!strcmp(st_n[st + 1], buf) ||
+                            (opts & OPT_MULTI && st == 3 &&
+                             !strcmp(*st_n, buf)))){
+                /* New machine after the run section */
+                if(st == 3){
+                    if(lockstep_ready(&tm))
+                        f_flush(&tm);
+                    if(tm.prof)
+                        profile_print(tm.prof, stderr);
+                    tm_reset(&tm);
+                    st = -1;
+                }
+                /* The machine is complete when run section starts */
+                if(++st == 3){
+                    t = tm_load(&tm);
+                    assert(!t);
+                }
                 continue;
             }
             if(st < 0) continue;
             buf_sz = strlen(buf);
-            lbuf = realloc(lbuf, lbuf_sz + buf_sz + 1);
-            assert(lbuf);
+            if(lbuf_sz + buf_sz + 1 > lbuf_cap){
+                lbuf_cap = 2 * (lbuf_sz + buf_sz + 1);
+                lbuf = realloc(lbuf, lbuf_cap);
+                assert(lbuf);
+            }
             strcpy(lbuf + lbuf_sz, buf);
             lbuf_sz += buf_sz;
         }
@@ -71,25 +125,81 @@ int main(){
          * Otherwise it is parsed if either the end of line or
          * the end of file is reached
          */
-        if(lbuf && (lbuf[lbuf_sz - 1] == '\n' || feof(stdin))){
+        if(lbuf_sz && (lbuf[lbuf_sz - 1] == '\n' || feof(stdin))){
             parse[st](lbuf, &tm);
-            free(lbuf);
-            lbuf = NULL;
             lbuf_sz = 0;
         }
     }
+    free(lbuf);
+    if(lockstep_ready(&tm))
+        f_flush(&tm);
+    if(tm.prof)
+        profile_print(tm.prof, stderr);
+    if(opts & OPT_STATS)
+        f_stats(&tm);
     tm_destroy(&tm);
     return EXIT_SUCCESS;
 }
 
+/******************** Options ********************/
+
+int f_opts(int argc, char **argv, struct machine *tm){
+    int i, opts = 0;
+    size_t j;
+    for(i = 1; i < argc; i++){
+        if(!strcmp(argv[i], "-v"))
+            opts |= OPT_STATS;
+        else if(!strcmp(argv[i], "-b"))
+            tm->lockstep = 1;
+        else if(!strcmp(argv[i], "-m"))
+            opts |= OPT_MULTI;
+        else if(!strcmp(argv[i], "-p")){
+            if(!tm->prof && !(tm->prof = new_profile()))
+                return -1;
+        }
+        else if(!strcmp(argv[i], "-s") && ++i < argc){
+            for(j = 0; j < sizeof(strategy_n) / sizeof(*strategy_n); j++)
+                if(!strcmp(argv[i], strategy_n[j]))
+                    break;
+            if(j == sizeof(strategy_n) / sizeof(*strategy_n))
+                return -1;
+            tm->strategy = j;
+        }
+        else
+            return -1;
+    }
+    return opts;
+}
+
+void f_stats(struct machine *tm){
+    fprintf(stderr, "states:   %lu -> %lu\n"
+                    "rules:    %lu -> %lu\n",
+            tm->stats.states, tm->stats.min_states,
+            tm->stats.rules,  tm->stats.min_rules);
+    fprintf(stderr, "strategy: %s\n"
+                    "runs:     %lu\n"
+                    "expanded: %lu\n"
+                    "branched: %lu\n"
+                    "shared:   %lu\n"
+                    "peak:     %lu\n"
+                    "macro:    %lu\n"
+                    "runaway:  %lu\n"
+                    "lockstep: %lu\n",
+            strategy_n[tm->strategy], tm->stats.runs, tm->stats.expanded,
+            tm->stats.branched, tm->stats.shared, tm->stats.peak,
+            tm->stats.macro,
+            tm->stats.runaway, tm->stats.lockstep);
+}
+
 /******************** Parser functions ********************/
 
-void f_tr(char *s, struct tm *tm){
+void f_tr(char *s, struct machine *tm){
     struct rule rule;
     symbol ch_f, ch_d;
     char mv;
-    sscanf(s, "%u %c %c %c %u", &rule.st_from, &ch_f, &ch_d, &mv,
-                                &rule.st_dest);
+    if(sscanf(s, "%u %c %c %c %u", &rule.st_from, &ch_f, &ch_d, &mv,
+                                   &rule.st_dest) != 5)
+        return;                /* Not a rule                           */
     rule.ch_from = ch_f == BLANK ? '\0' : ch_f; /* Blanks are replaced */
     rule.ch_dest = ch_d == BLANK ? '\0' : ch_d; /* with zeroes,        */
     switch(mv){                /* Moves with their corresponding value */
@@ -104,27 +214,41 @@ void f_tr(char *s, struct tm *tm){
     }
     int t = rule_dict_insert(tm->rules, &rule);
     assert(!t);
-    set_max(tm->accept, rule.st_from > rule.st_dest ?
-                        rule.st_from : rule.st_dest );
 }
 
-void f_acc(char *s, struct tm *tm){
-    int t = set_put(tm->accept, atoi(s));
+void f_acc(char *s, struct machine *tm){
+    int t = set_put(tm->accept, strtoul(s, NULL, 10));
     assert(t);
 }
 
-void f_max(char *s, struct tm *tm){
+void f_max(char *s, struct machine *tm){
     tm->max = atoi(s);
 }
 
-void f_run(char *s, struct tm *tm){
+void f_run(char *s, struct machine *tm){
     tape *t = tape_init(s, BLANK, "\n");
     assert(t);
-    struct tmconf *conf = calloc(1, sizeof(*conf));
+    struct tmconf *conf = new_tmconf(1);
     assert(conf);
-    conf->ttl = tm->max;
-    conf->t   = t;
+    conf->ttl   = tm->max;
+    conf->t     = t;
+    conf->n     = 1;
+    conf->st[0] = 0;
+    if(lockstep_ready(tm)){
+        if(lockstep_put(tm, conf))
+            f_flush(tm);
+        return;
+    }
     int v = tm_run(tm, conf);
     assert(v >= 0);
     printf("%c\n", v[OUT]);
 }
+
+void f_flush(struct machine *tm){
+    size_t i, n;
+    int *v = lockstep_run(tm, &n);
+    for(i = 0; i < n; i++){
+        assert(v[i] >= 0);
+        printf("%c\n", v[i][OUT]);
+    }
+}
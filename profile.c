@@ -0,0 +1,202 @@
+/*
+ * profile.c: Run latency and hardware counters
+ *
+ * Author:    Giorgio Pristia
+ *
+ * Each run is timed into a log-linear histogram, as in HDR histograms:
+ * latencies below 2^PROF_SUB_BITS ns have a bucket each, then every
+ * power of two is split in 2^PROF_SUB_BITS buckets, so percentiles are
+ * within 1/2^PROF_SUB_BITS of the true value at any magnitude.
+ * On Linux the events are opened in a group with perf_event_open, user
+ * space only, and enabled just around the run. Events that can not be
+ * opened, as when perf events are not permitted, are left out.
+ * Runs are timed with the monotonic clock where POSIX provides it, else
+ * with the wall clock of C11, which may be stepped while timing.
+ */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+#define NSEC 1000000000ULL
+
+const char * const prof_event_n[] =
+    {"cycles", "instructions", "cache misses", "branch misses"};
+
+/* Open the events in a group, leaving out those not available */
+void               profile_open  (struct profile*);
+/* Bucket of latency v, and the highest latency in bucket i */
+size_t             prof_bucket   (unsigned long long v);
+unsigned long long prof_bucket_max(size_t i);
+/* Latency below which a fraction q of the runs fall */
+unsigned long long prof_pct      (struct profile*, double q);
+/* Time in nanoseconds */
+unsigned long long prof_now      ();
+
+struct profile *new_profile(){
+    struct profile *p = calloc(1, sizeof(*p));
+    if(p)
+        profile_open(p);
+    return p;
+}
+
+#ifdef __linux__
+void profile_open(struct profile *p){
+    const unsigned long long config[] =
+        {PERF_COUNT_HW_CPU_CYCLES,   PERF_COUNT_HW_INSTRUCTIONS,
+         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    struct perf_event_attr a;
+    int i;
+    p->leader = -1;
+    for(i = 0; i < PROF_EVENTS; i++){
+        memset(&a, 0, sizeof(a));
+        a.type           = PERF_TYPE_HARDWARE;
+        a.size           = sizeof(a);
+        a.config         = config[i];
+        a.read_format    = PERF_FORMAT_GROUP;
+        a.disabled       = p->leader < 0;
+        a.exclude_kernel = 1;
+        a.exclude_hv     = 1;
+        p->fd[i] = syscall(SYS_perf_event_open, &a, 0, -1, p->leader, 0);
+        if(p->fd[i] >= 0 && p->leader < 0)
+            p->leader = p->fd[i];
+    }
+}
+#else
+void profile_open(struct profile *p){
+    int i;
+    for(i = 0; i < PROF_EVENTS; i++)
+        p->fd[i] = -1;
+    p->leader = -1;
+}
+#endif
+
+void profile_start(struct profile *p){
+#ifdef __linux__
+    if(p->leader >= 0){
+        ioctl(p->leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+        ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    p->t0 = prof_now();
+}
+
+void profile_stop(struct profile *p, size_t batch){
+    unsigned long long v = prof_now() - p->t0;
+#ifdef __linux__
+    /* Number of events, then their values in the order they were opened */
+    unsigned long long r[1 + PROF_EVENTS];
+    int i, j;
+    if(p->leader >= 0){
+        ioctl(p->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if(read(p->leader, r, sizeof(r)) > 0)
+            for(i = 0, j = 1; i < PROF_EVENTS; i++)
+                if(p->fd[i] >= 0 && (unsigned long long)j <= *r)
+                    p->count[i] += r[j++];
+    }
+#endif
+    if((long long)v < 0) /* The wall clock stepped back */
+        v = 0;
+    p->hist[prof_bucket(v)]++;
+    p->n++;
+    p->strings += batch;
+    p->sum += v;
+    if(v > p->max)
+        p->max = v;
+}
+
+void profile_print(struct profile *p, FILE *f){
+    const char *unit = p->strings ? "batch" : "run";
+    int i;
+    p->machine++;
+    if(!p->n)
+        return;
+    if(p->strings)
+        fprintf(f, "profile:  machine %u, %lu lockstep batches of %lu "
+                   "strings\n", p->machine, p->n, p->strings);
+    else
+        fprintf(f, "profile:  machine %u, %lu runs\n", p->machine, p->n);
+    fprintf(f, "latency:  mean %llu p50 %llu p99 %llu p999 %llu max %llu ns "
+               "per %s\n", p->sum / p->n, prof_pct(p, .5), prof_pct(p, .99),
+            prof_pct(p, .999), p->max, unit);
+    if(p->leader < 0)
+        fprintf(f, "counters: unavailable\n");
+    else for(i = 0; i < PROF_EVENTS; i++){
+        if(p->fd[i] < 0)
+            fprintf(f, "%-14s n/a\n", prof_event_n[i]);
+        else
+            fprintf(f, "%-14s %llu (%llu per %s)\n", prof_event_n[i],
+                    p->count[i], p->count[i] / p->n, unit);
+    }
+    if(p->fd[prof_cycles] >= 0 && p->fd[prof_instructions] >= 0 &&
+       p->count[prof_cycles])
+        fprintf(f, "%-14s %.2f\n", "ipc", (double)p->count[prof_instructions]
+                                          / p->count[prof_cycles]);
+    memset(p->hist,  0, sizeof(p->hist));
+    memset(p->count, 0, sizeof(p->count));
+    p->n = p->strings = 0;
+    p->sum = p->max = 0;
+}
+
+void delete_profile(struct profile *p){
+    int i;
+    if(!p)
+        return;
+#ifdef __linux__
+    for(i = PROF_EVENTS; i--;)
+        if(p->fd[i] >= 0)
+            close(p->fd[i]);
+#else
+    (void)i;
+#endif
+    free(p);
+}
+
+size_t prof_bucket(unsigned long long v){
+    int e, s;
+    if(v < 1U << PROF_SUB_BITS)
+        return v;
+    for(e = 0, s = 32; s; s >>= 1) /* Index of the highest bit set */
+        if(v >> (e + s))
+            e += s;
+    return ((size_t)(e - PROF_SUB_BITS + 1) << PROF_SUB_BITS) +
+           ((v >> (e - PROF_SUB_BITS)) & ((1U << PROF_SUB_BITS) - 1));
+}
+
+unsigned long long prof_bucket_max(size_t i){
+    int e;
+    if(i < 1U << PROF_SUB_BITS)
+        return i;
+    e = (i >> PROF_SUB_BITS) - 1;
+    return (((unsigned long long)(i & ((1U << PROF_SUB_BITS) - 1)) +
+             (1U << PROF_SUB_BITS) + 1) << e) - 1;
+}
+
+unsigned long long prof_pct(struct profile *p, double q){
+    unsigned long c = 0, k = q * p->n;
+    size_t i;
+    if(k < q * p->n || !k) /* Rank of the run, rounded up */
+        k++;
+    for(i = 0; i < PROF_BUCKETS; i++)
+        if((c += p->hist[i]) >= k)
+            break;
+    return i < PROF_BUCKETS && prof_bucket_max(i) < p->max ?
+           prof_bucket_max(i) : p->max;
+}
+
+unsigned long long prof_now(){
+    struct timespec t;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &t);
+#else
+    timespec_get(&t, TIME_UTC);
+#endif
+    return t.tv_sec * NSEC + t.tv_nsec;
+}
@@ -0,0 +1,58 @@
+/*
+ * profile.h: Run latency and hardware counters
+ *
+ * Author:    Giorgio Pristia
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+/* Latency histogram with 2^PROF_SUB_BITS buckets per power of two */
+#define PROF_SUB_BITS 4
+#define PROF_BUCKETS  ((65 - PROF_SUB_BITS) << PROF_SUB_BITS)
+
+/* Hardware counters read around each run, where available */
+enum prof_event{
+    prof_cycles,
+    prof_instructions,
+    prof_cache_misses,
+    prof_branch_misses,
+    PROF_EVENTS
+};
+
+struct profile{
+    unsigned long      hist[PROF_BUCKETS]; /* Runs by latency bucket      */
+    unsigned long      n;                  /* Runs or batches timed       */
+    unsigned long      strings;            /* Strings in lockstep batches */
+    unsigned long long sum, max;           /* Latency in nanoseconds      */
+    unsigned long long count[PROF_EVENTS]; /* Counters summed over runs   */
+    int                fd[PROF_EVENTS];    /* Counter events, -1 if none  */
+    int                leader;             /* Group of the events, or -1  */
+    unsigned int       machine;            /* Summaries printed           */
+    unsigned long long t0;                 /* Start of the current run    */
+};
+
+/*
+ * Return a new profile, opening the hardware counters if permitted,
+ * else NULL
+ */
+struct profile *new_profile   ();
+
+/*
+ * Time a run and count events from start to stop, batch is the number
+ * of strings run in lockstep, or 0 for a single run
+ */
+void            profile_start (struct profile*);
+void            profile_stop  (struct profile*, size_t batch);
+
+/*
+ * Print a summary of the runs since the last one, then clear them,
+ * latencies are per batch if strings were run in lockstep
+ */
+void            profile_print (struct profile*, FILE*);
+
+void            delete_profile(struct profile*);
+
+#endif
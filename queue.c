@@ -5,11 +5,35 @@
  *
  * This queue is used to store configurations in BFS
  * (dequeue) tail => => => head (enqueue)
+ * and, pushing on the tail instead, as a stack in DFS
+ * (dequeue) tail <= (push)
  */
 
 #include <stdlib.h>
 #include "queue.h"
 
+struct tmconf *new_tmconf(size_t n){
+    struct tmconf *conf = malloc(sizeof(*conf) + n * sizeof(state));
+    if(conf){
+        conf->ttl  = 0;
+        conf->t    = NULL;
+        conf->next = NULL;
+        conf->n    = 0;
+        conf->size = n;
+    }
+    return conf;
+}
+
+struct tmconf *tmconf_resize(struct tmconf *conf, size_t n){
+    struct tmconf *c;
+    if(n <= conf->size)
+        return conf;
+    if(!(c = realloc(conf, sizeof(*c) + n * sizeof(state))))
+        return NULL;
+    c->size = n;
+    return c;
+}
+
 void delete_tmconf(struct tmconf *conf){
         delete_tape(conf->t);
         free(conf);
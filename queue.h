@@ -15,16 +15,32 @@ struct queue{
     struct tmconf *tail;
 };
 
+/*
+ * A tape with the set of states the machine may be in on it, sorted and
+ * without duplicates, so that branches writing and moving the same way
+ * share one tape
+ */
 struct tmconf{
-    state          st;
     unsigned int   ttl;
     tape          *t;
     struct tmconf *next;
+    size_t         n;    /* States in the set          */
+    size_t         size; /* Room for states in the set */
+    state          st[];
 };
 
 typedef struct queue queue;
 
-void delete_tmconf(struct tmconf*);
+/* Return a configuration with room for n states and no tape, or NULL */
+struct tmconf *new_tmconf   (size_t n);
+
+/*
+ * Make room for n states, the configuration may be moved
+ * Return the configuration, or NULL leaving it unchanged
+ */
+struct tmconf *tmconf_resize(struct tmconf*, size_t n);
+
+void           delete_tmconf(struct tmconf*);
 
 queue         *new_queue   ();
 
@@ -34,6 +50,13 @@ static inline void enqueue(queue *q, struct tmconf *conf){
     q->tail       = conf  ) ;
 }
 
+/* Insert at the tail, so that the configuration is dequeued first (LIFO) */
+static inline void push(queue *q, struct tmconf *conf){
+    if(!(conf->next = q->tail))
+        q->head = conf;
+    q->tail = conf;
+}
+
 static inline struct tmconf *dequeue(queue *q){
     struct tmconf *conf;
     if((conf = q->tail)){
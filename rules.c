@@ -11,6 +11,8 @@
  * in the correct list of the dictionary. Otherwise a new element
  * is inserted in the dictionary with a single destination in its list.
  * Hash table grows twice larger when the dictionary is 3/4 full.
+ * When the dictionary is reset, its table is cleared and the nodes are
+ * kept in pools, so that a new machine is loaded without allocations.
  *
  * (state, symbol) => [(state, move, symbol) -> (state, move, symbol) -> ]
  */
@@ -27,11 +29,11 @@ void       rule_list_push(rule_list **list, rule_list *new);
  *         -1 if malloc fails on new rule
  *         -2 if rule_dest_push call fails on existing rule
  */
-int        rule_list_insert(rule_list**, hash, struct rule*);
+int        rule_list_insert(rule_dict*, rule_list**, hash, struct rule*);
 void       delete_rule_list(rule_list*);
 
 /* Return 0 on success, else -1 */
-int        rule_dest_push  (rule_dest**, state, int, symbol);
+int        rule_dest_push  (rule_dest **pool, rule_dest**, state, int, symbol);
 void       delete_rule_dest(rule_dest*);
 
 /******************** Dictionary ********************/
@@ -47,6 +49,8 @@ rule_dict *new_rule_dict(){
     }
     dict->size  = DICT_MINSZ;
     dict->count = 0;
+    dict->pool_list = NULL;
+    dict->pool_dest = NULL;
     return dict;
 }
 
@@ -73,7 +77,7 @@ int rule_dict_insert(rule_dict *dict, struct rule *rule){
      * Increase dictionary count only when a new rule is inserted
      * and not when a new destination is added to an existing rule
      */
-    int t = rule_list_insert(dict->rule + h % dict->size, h, rule);
+    int t = rule_list_insert(dict, dict->rule + h % dict->size, h, rule);
     if(t < 0)
         return -1;
     dict->count += t;
@@ -82,10 +86,31 @@ int rule_dict_insert(rule_dict *dict, struct rule *rule){
     return 0;
 }
 
+void rule_dict_reset(rule_dict *dict){
+    size_t i;
+    rule_list *j, *k;
+    rule_dest *d;
+    for(i = 0; i < dict->size; i++){
+        for(j = dict->rule[i]; j; j = k){
+            k = j->next;
+            while((d = j->dest)){
+                j->dest = d->next;
+                d->next = dict->pool_dest;
+                dict->pool_dest = d;
+            }
+            rule_list_push(&dict->pool_list, j);
+        }
+        dict->rule[i] = NULL;
+    }
+    dict->count = 0;
+}
+
 void delete_rule_dict(rule_dict *dict){
     size_t i;
     for(i = 0; i < dict->size; i++)
         delete_rule_list(dict->rule[i]);
+    delete_rule_list(dict->pool_list);
+    delete_rule_dest(dict->pool_dest);
     free(dict->rule);
     free(dict);
 }
@@ -97,21 +122,25 @@ void rule_list_push(rule_list **list, rule_list *new){
         *list     = new;
 }
 
-int rule_list_insert(rule_list **list, hash h, struct rule *rule){
+int rule_list_insert(rule_dict *dict, rule_list **list, hash h,
+                     struct rule *rule){
     int        incr = 0;
     rule_list *new  = rule_list_find(*list, rule->st_from, rule->ch_from);
     if(!new){
-        new       = malloc(sizeof(*new));
-        if(!new)
+        if((new = dict->pool_list))
+            dict->pool_list = new->next;
+        else if(!(new = malloc(sizeof(*new))))
             return -1;
         new->hash = h;
         new->st   = rule->st_from;
         new->ch   = rule->ch_from;
         new->dest = NULL;
+        new->macro = NULL;
+        new->runaway = 0;
         rule_list_push(list, new);
         incr      = 1;
     }
-    if(rule_dest_push(&new->dest, rule->st_dest,
+    if(rule_dest_push(&dict->pool_dest, &new->dest, rule->st_dest,
                       rule->mv_dest, rule->ch_dest) < 0)
         return -2;
     return incr;
@@ -129,14 +158,18 @@ void delete_rule_list(rule_list *list){
 
 /******************** Destination ********************/
 
-int rule_dest_push(rule_dest **dest, state st, int mv, symbol ch){
-    rule_dest *new = malloc(sizeof(*new));
-    if(!new)
+int rule_dest_push(rule_dest **pool, rule_dest **dest,
+                   state st, int mv, symbol ch){
+    rule_dest *new;
+    if((new = *pool))
+        *pool = new->next;
+    else if(!(new = malloc(sizeof(*new))))
         return -1;
     new->next = *dest;
     new->st   = st;
     new->mv   = mv;
     new->ch   = ch;
+    new->acc  = 0;
     *dest     = new;
     return 0;
 }
@@ -27,14 +27,20 @@ struct rule_dict{
     rule_list **rule;
     size_t      size,
                 count;
+    rule_list  *pool_list; /* Nodes of deleted rules, to be reused */
+    rule_dest  *pool_dest;
 };
 
 struct rule_list{
-    hash        hash;
-    state       st;
-    symbol      ch;
-    rule_dest  *dest;
-    rule_list  *next;
+    hash          hash;
+    state         st;
+    symbol        ch;
+    rule_dest    *dest;
+    rule_list    *next;
+    unsigned int  dist;    /* Heuristic estimate, see heuristic.c   */
+    struct macro *macro;   /* Macro step from this rule, see macro.c */
+    int           runaway; /* Direction of a runaway, see macro.c    */
+    int           share;   /* Destinations sharing a tape, see core.c */
 };
 
 /* List of non deterministic destinations for each rule */
@@ -42,6 +48,7 @@ struct rule_dest{
     state       st;
     int         mv;
     symbol      ch;
+    char        acc;   /* True if st is an accepting state */
     rule_dest  *next;
 };
 
@@ -60,15 +67,21 @@ static inline rule_list *rule_list_find(rule_list *rule, state st, symbol ch){
     return NULL;
 }
 
-static inline rule_dest *rule_dict_find(rule_dict *dict, state st, symbol ch){
+static inline rule_list *rule_dict_lookup(rule_dict *dict,
+                                          state st, symbol ch){
     hash h = hash_f(st, ch);
-    rule_list *r =
-        rule_list_find(dict->rule[h % dict->size], st, ch);
+    return rule_list_find(dict->rule[h % dict->size], st, ch);
+}
+
+static inline rule_dest *rule_dict_find(rule_dict *dict, state st, symbol ch){
+    rule_list *r = rule_dict_lookup(dict, st, ch);
     return r ? r->dest : NULL;
 }
 
 /* Return 0 on success, else -1 */
 int        rule_dict_insert(rule_dict*, struct rule*);
+/* Remove all the rules, keeping their memory for the next ones */
+void       rule_dict_reset (rule_dict*);
 void       delete_rule_dict(rule_dict*);
 
 #endif
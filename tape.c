@@ -19,8 +19,15 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "tape.h"
 
+#define WORD_BYTES sizeof(uint64_t)
+#define WORD_ONES  UINT64_C(0x0101010101010101)
+
+size_t span_up  (symbol*, size_t n, symbol ch, char *set);
+size_t span_down(symbol*, size_t n, symbol ch, char *set);
+
 tape *tape_branch(tape *t){
     tape *tnew = calloc(1, sizeof(*tnew));
     if(t && tnew) for(int i = 0; i <= 1; i++){
@@ -40,6 +47,8 @@ tape *tape_init(symbol *s, symbol blank, symbol *term){
     tape *t  = tape_branch(NULL);
     if(!t) return NULL; 
     t->size[1] = strcspn(s, term);
+    if(!t->size[1])   /* Empty string, the head is on a blank */
+        t->size[1] = 1;
     t->tail[1] = calloc(t->size[1], sizeof(**t->tail));
     for(size_t l = 0; s[l] && s[l] != *term; l++)
         if(s[l] != blank)
@@ -47,6 +56,103 @@ tape *tape_init(symbol *s, symbol blank, symbol *term){
     return t;
 }
 
+size_t tape_span(tape *t, int mv, symbol ch, char *set, size_t max){
+    size_t n = 0, i, len, m;
+    long   p = t->head;
+    symbol *a;
+    int    up;
+    while(n < max){
+        if(p >= 0){
+            a  = t->tail[1];
+            i  = p;
+            len = t->size[1];
+            up = mv > 0;
+        }
+        else{ /* Left tail is reversed */
+            a  = t->tail[0];
+            i  = ~p;
+            len = t->size[0];
+            up = mv < 0;
+        }
+        if(i >= len) /* Beyond the tape there are only blanks */
+            return (set ? set[0] : !ch) ? max : n;
+        /* Cells left in this tail, in the direction of the head */
+        len = up ? len - i : i + 1;
+        if(len > max - n)
+            len = max - n;
+        m  = up ? span_up  (a + i, len, ch, set)
+                : span_down(a + i, len, ch, set);
+        n += m;
+        p += (long)m * mv;
+        if(m < len)
+            break;
+    }
+    return n;
+}
+
+tape *tape_skip(tape *t, size_t n, int mv){
+    long h = t->head + (long)n * mv;
+    symbol *a;
+    if(h >= (signed)t->size[1]){
+        if(!(a = realloc(t->tail[1], (h + 1) * sizeof(*a))))
+            return NULL;
+        memset(a + t->size[1], 0, h + 1 - t->size[1]);
+        t->tail[1] = a;
+        t->size[1] = h + 1;
+    }
+    else if(h < -(signed)t->size[0]){
+        if(!(a = realloc(t->tail[0], -h * sizeof(*a))))
+            return NULL;
+        memset(a + t->size[0], 0, -h - t->size[0]);
+        t->tail[0] = a;
+        t->size[0] = -h;
+    }
+    t->head = h;
+    return t;
+}
+
+/*
+ * Spans over a single symbol compare a word at a time,
+ * as memchr does, then finish byte by byte, spans over
+ * a set look each symbol up in its table
+ */
+size_t span_up(symbol *a, size_t n, symbol ch, char *set){
+    size_t   i = 0;
+    uint64_t w, pat = (unsigned char)ch * WORD_ONES;
+    if(set){
+        while(i < n && set[(unsigned char)a[i]])
+            i++;
+        return i;
+    }
+    for(; i + WORD_BYTES <= n; i += WORD_BYTES){
+        memcpy(&w, a + i, WORD_BYTES);
+        if(w != pat)
+            break;
+    }
+    while(i < n && a[i] == ch)
+        i++;
+    return i;
+}
+
+/* Same as span_up but from a[0] down to a[1 - n] */
+size_t span_down(symbol *a, size_t n, symbol ch, char *set){
+    size_t   i = 0;
+    uint64_t w, pat = (unsigned char)ch * WORD_ONES;
+    if(set){
+        while(i < n && set[(unsigned char)*(a - i)])
+            i++;
+        return i;
+    }
+    for(; i + WORD_BYTES <= n; i += WORD_BYTES){
+        memcpy(&w, a - i - (WORD_BYTES - 1), WORD_BYTES);
+        if(w != pat)
+            break;
+    }
+    while(i < n && *(a - i) == ch)
+        i++;
+    return i;
+}
+
 void delete_tape(tape *t){
     for(int i = 0; i <= 1; i++)
         free(t->tail[i]);
@@ -27,11 +27,26 @@ tape  *tape_init  (symbol*, symbol blank, symbol *term);
 /* Branch the current tape and return a pointer to the new copy created */
 tape  *tape_branch(tape*);
 
+/*
+ * Count the cells from the head on, moving by mv, that hold ch or,
+ * if set is not NULL, any symbol c with set[c] not zero, as a table of
+ * all the symbols. Counting stops at max, cells beyond the tape are
+ * blank. The tape is not modified.
+ */
+size_t tape_span  (tape*, int mv, symbol ch, char *set, size_t max);
+/* Move the head n cells by mv, growing the tape if needed */
+tape  *tape_skip  (tape*, size_t n, int mv);
+
 static inline symbol tape_read(tape *t){
     if(t->head < 0) return t->tail[0][~t->head];
     return t->tail[1][t->head];
 }
 
+/* True if the head is on the last cell of the tape moving by mv */
+static inline int tape_edge(tape *t, int mv){
+    return t->head == (mv > 0 ? (long)t->size[1] - 1 : -(long)t->size[0]);
+}
+
 static inline tape *tape_write(tape *t, symbol write, int move){
     if(t->head < 0) t->tail[0][~t->head] = write;
     else t->tail[1][t->head] = write;
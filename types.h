@@ -7,6 +7,14 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+/*
+ * POSIX clocks and syscall, see profile.c. The Makefile defines it for
+ * every source, this is for the single file where types.h comes first
+ */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
 typedef unsigned int state;
 typedef char         symbol;
 